@@ -0,0 +1,137 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "include/core/SkFontMgr.h"
+#include "include/core/SkPoint.h"
+#include "modules/skparagraph/include/FontCollection.h"
+#include "modules/skparagraph/include/Paragraph.h"
+#include "modules/skparagraph/include/ParagraphBuilder.h"
+#include "modules/skunicode/include/SkUnicode_icu.h"
+
+#include "BulkParagraphLayout.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+sk_sp<SkTextBlob> make_blob(skia::textlayout::Paragraph* paragraph) {
+  SkTextBlobBuilder builder;
+  paragraph->visit([&builder](int, const skia::textlayout::Paragraph::VisitorInfo* info) {
+    if (!info || info->count == 0) {
+      return;  // end of line
+    }
+    const SkTextBlobBuilder::RunBuffer& run =
+        builder.allocRunPos(info->font, info->count);
+    memcpy(run.glyphs, info->glyphs, info->count * sizeof(SkGlyphID));
+    for (int i = 0; i < info->count; ++i) {
+      run.points()[i] = info->positions[i] + info->origin;
+    }
+  });
+  return builder.make();
+}
+
+}  // namespace
+
+BulkParagraphLayout::BulkParagraphLayout(sk_sp<SkFontMgr> fontMgr,
+                                         skia::textlayout::ParagraphStyle style,
+                                         int threads)
+    : font_mgr_(std::move(fontMgr)),
+      style_(std::move(style)),
+      threads_(threads > 0
+                   ? threads
+                   : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))) {
+  for (int t = 0; t < threads_; ++t) {
+    auto worker = std::make_unique<Worker>();
+    worker->collection = sk_make_sp<skia::textlayout::FontCollection>();
+    worker->collection->setDefaultFontManager(font_mgr_);
+    worker->unicode = SkUnicodes::ICU::Make();
+    if (!worker->unicode) {
+      valid_ = false;
+      workers_.clear();
+      return;
+    }
+    workers_.push_back(std::move(worker));
+  }
+  // Worker 0 is the thread that calls layout().
+  for (int t = 1; t < threads_; ++t) {
+    pool_.emplace_back(&BulkParagraphLayout::thread_main, this, workers_[t].get());
+  }
+}
+
+BulkParagraphLayout::~BulkParagraphLayout() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  start_.notify_all();
+  for (std::thread& t : pool_) {
+    t.join();
+  }
+}
+
+void BulkParagraphLayout::run(Worker* worker) {
+  const std::vector<std::string>& texts = *texts_;
+  std::vector<LaidOutParagraph>& results = *results_;
+  for (size_t i = next_++; i < texts.size(); i = next_++) {
+    std::unique_ptr<skia::textlayout::ParagraphBuilder> builder =
+        skia::textlayout::ParagraphBuilder::make(style_, worker->collection,
+                                                 worker->unicode);
+    builder->addText(texts[i].c_str(), texts[i].size());
+    std::unique_ptr<skia::textlayout::Paragraph> paragraph = builder->Build();
+    paragraph->layout(width_);
+    results[i].blob = make_blob(paragraph.get());
+    results[i].height = paragraph->getHeight();
+  }
+}
+
+void BulkParagraphLayout::thread_main(Worker* worker) {
+  uint64_t seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [&] { return quit_ || generation_ != seen; });
+      if (quit_) {
+        return;
+      }
+      seen = generation_;
+    }
+    this->run(worker);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --busy_;
+    }
+    done_.notify_one();
+  }
+}
+
+std::vector<LaidOutParagraph> BulkParagraphLayout::layout(
+    const std::vector<std::string>& texts, SkScalar width) {
+  std::vector<LaidOutParagraph> results;
+  if (!valid_) {
+    return results;
+  }
+  results.resize(texts.size());
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    texts_ = &texts;
+    results_ = &results;
+    width_ = width;
+    next_ = 0;
+    busy_ = static_cast<int>(pool_.size());
+    ++generation_;
+  }
+  start_.notify_all();
+  this->run(workers_[0].get());
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [&] { return busy_ == 0; });
+  texts_ = nullptr;
+  results_ = nullptr;
+  return results;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef BulkParagraphLayout_DEFINED
+#define BulkParagraphLayout_DEFINED
+
+#include "include/core/SkRefCnt.h"
+#include "include/core/SkScalar.h"
+#include "include/core/SkTextBlob.h"
+#include "modules/skparagraph/include/ParagraphStyle.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class SkFontMgr;
+class SkUnicode;
+
+namespace skia::textlayout {
+class FontCollection;
+}
+
+struct LaidOutParagraph {
+  sk_sp<SkTextBlob> blob;  // glyphs positioned relative to the paragraph's top-left
+  SkScalar height = 0;
+};
+
+// Shapes and lays out many independent paragraphs on a pool of threads.
+//
+// The font manager (e.g. OneFontMgr) and its typefaces are shared by every thread; they
+// are immutable and SkTypeface is thread-safe. skparagraph's FontCollection and SkUnicode
+// are not: the collection fills its typeface and paragraph caches as it goes. So each
+// worker has its own collection on top of the shared font manager, and its own SkUnicode.
+//
+// The worker threads and their state are created once, in the constructor, and kept until
+// the object is destroyed, so the caches carry over from one layout() call to the next and
+// thread and ICU startup are not paid per batch. The calling thread is worker 0; layout()
+// must not be called from several threads at once.
+//
+// The result is one SkTextBlob per paragraph, in input order, to be painted serially.
+// Only glyphs and positions are kept, not paint styles.
+class BulkParagraphLayout {
+ public:
+  // threads == 0 uses one per core.
+  BulkParagraphLayout(sk_sp<SkFontMgr> fontMgr,
+                      skia::textlayout::ParagraphStyle style,
+                      int threads = 0);
+  ~BulkParagraphLayout();
+
+  BulkParagraphLayout(const BulkParagraphLayout&) = delete;
+  BulkParagraphLayout& operator=(const BulkParagraphLayout&) = delete;
+
+  // False if the per-worker state could not be created (e.g. ICU is unavailable); layout()
+  // then returns no paragraphs.
+  bool valid() const { return valid_; }
+
+  std::vector<LaidOutParagraph> layout(const std::vector<std::string>& texts,
+                                       SkScalar width);
+
+  int threads() const { return threads_; }
+
+ private:
+  struct Worker {
+    sk_sp<skia::textlayout::FontCollection> collection;
+    sk_sp<SkUnicode> unicode;
+  };
+
+  // Lays out paragraphs from the current job until there are none left.
+  void run(Worker* worker);
+  void thread_main(Worker* worker);
+
+  sk_sp<SkFontMgr> font_mgr_;
+  skia::textlayout::ParagraphStyle style_;
+  int threads_;
+  bool valid_ = true;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> pool_;
+
+  // The current job, published to the pool under mutex_.
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  uint64_t generation_ = 0;
+  int busy_ = 0;
+  bool quit_ = false;
+  const std::vector<std::string>* texts_ = nullptr;
+  std::vector<LaidOutParagraph>* results_ = nullptr;
+  SkScalar width_ = 0;
+  std::atomic<size_t> next_{0};
+};
+
+#endif
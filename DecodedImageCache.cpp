@@ -0,0 +1,240 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "include/codec/SkCodec.h"
+#include "include/core/SkBitmap.h"
+#include "include/core/SkData.h"
+#include "include/core/SkImageInfo.h"
+#include "include/core/SkSamplingOptions.h"
+
+#include "DecodedImageCache.h"
+
+#include <cmath>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+uint64_t DecodedImageCache::HashContent(const void* data, size_t size) {
+    return std::hash<std::string_view>()(
+            std::string_view(static_cast<const char*>(data), size));
+}
+
+sk_sp<SkImage> DecodedImageCache::find(const Key& key, const SkData& content, bool countMiss) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    auto found = fIndex.find(key);
+    if (found == fIndex.end() || !found->second->fContent->equals(&content)) {
+        if (countMiss) {
+            fStats.fMisses++;
+        }
+        return nullptr;
+    }
+    fStats.fHits++;
+    fLRU.splice(fLRU.begin(), fLRU, found->second);
+    return found->second->fImage;
+}
+
+void DecodedImageCache::add(const Key& key, sk_sp<SkData> content, sk_sp<SkImage> image) {
+    if (!image || !content) {
+        return;
+    }
+    size_t bytes = image->imageInfo().computeMinByteSize();
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    if (fIndex.find(key) != fIndex.end()) {
+        // Another thread decoded the same frame first; keep its copy. (If the
+        // entry is for different bytes with a colliding hash, this frame simply
+        // stays uncached.)
+        return;
+    }
+    fLRU.push_front({key, std::move(content), std::move(image), bytes});
+    fIndex[key] = fLRU.begin();
+    fBytes += bytes;
+    this->purgeLocked();
+}
+
+void DecodedImageCache::setByteBudget(size_t budget) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fBudget = budget;
+    this->purgeLocked();
+}
+
+DecodedImageCache::Stats DecodedImageCache::stats() const {
+    std::lock_guard<std::mutex> lock(fMutex);
+    Stats stats = fStats;
+    stats.fBytes = fBytes;
+    stats.fBudget = fBudget;
+    return stats;
+}
+
+void DecodedImageCache::purgeLocked() {
+    // Never evict the entry we just added, even if it alone exceeds the budget.
+    while (fBytes > fBudget && fLRU.size() > 1) {
+        const Entry& victim = fLRU.back();
+        fBytes -= victim.fBytes;
+        fIndex.erase(victim.fKey);
+        fLRU.pop_back();
+        fStats.fEvictions++;
+    }
+}
+
+namespace {
+
+class CachedImageAsset final : public skresources::ImageAsset {
+public:
+    static sk_sp<CachedImageAsset> Make(sk_sp<SkData> data, sk_sp<DecodedImageCache> cache) {
+        uint64_t hash = DecodedImageCache::HashContent(data->data(), data->size());
+        size_t size = data->size();
+        std::unique_ptr<SkCodec> codec = SkCodec::MakeFromData(data);
+        if (!codec) {
+            return nullptr;
+        }
+        return sk_sp<CachedImageAsset>(new CachedImageAsset(std::move(data), std::move(codec),
+                                                            std::move(cache), hash, size));
+    }
+
+    bool isMultiFrame() override { return fFrameInfos.size() > 1; }
+
+    FrameData getFrameData(float t) override {
+        return {this->frame(this->frameIndexForTime(t)),
+                SkSamplingOptions(SkFilterMode::kLinear, SkMipmapMode::kNearest),
+                SkMatrix::I(),
+                SizeFit::kCenter};
+    }
+
+private:
+    CachedImageAsset(sk_sp<SkData> data, std::unique_ptr<SkCodec> codec,
+                     sk_sp<DecodedImageCache> cache, uint64_t hash, size_t size)
+        : fData(std::move(data))
+        , fCodec(std::move(codec))
+        , fCache(std::move(cache))
+        , fContentHash(hash)
+        , fContentSize(size)
+        , fFrameInfos(fCodec->getFrameInfo()) {
+        for (const auto& info : fFrameInfos) {
+            fTotalDuration += info.fDuration;
+        }
+    }
+
+    int frameIndexForTime(float t) const {
+        if (fFrameInfos.size() <= 1 || fTotalDuration <= 0) {
+            return 0;
+        }
+        double ms = std::fmod(std::max(0.0, static_cast<double>(t) * 1000), fTotalDuration);
+        for (size_t i = 0; i < fFrameInfos.size(); ++i) {
+            ms -= fFrameInfos[i].fDuration;
+            if (ms < 0) {
+                return static_cast<int>(i);
+            }
+        }
+        return static_cast<int>(fFrameInfos.size()) - 1;
+    }
+
+    DecodedImageCache::Key keyFor(int frameIndex) const {
+        return {fContentHash, fContentSize, frameIndex};
+    }
+
+    sk_sp<SkImage> frame(int frameIndex) {
+        if (auto image = fCache->find(this->keyFor(frameIndex), *fData, /*countMiss=*/false)) {
+            return image;
+        }
+
+        // SkCodec is not thread-safe. Concurrent requests for the same asset queue up
+        // here, and all but the first find the frame in the cache. The miss is counted
+        // here, where a decode follows.
+        std::lock_guard<std::mutex> lock(fCodecMutex);
+        if (auto image = fCache->find(this->keyFor(frameIndex), *fData)) {
+            return image;
+        }
+
+        SkImageInfo info = fCodec->getInfo().makeColorType(kN32_SkColorType)
+                                            .makeAlphaType(kPremul_SkAlphaType);
+        SkBitmap bitmap;
+        if (!bitmap.tryAllocPixels(info)) {
+            return nullptr;
+        }
+
+        SkCodec::Options options;
+        options.fFrameIndex = frameIndex;
+        if (frameIndex > 0 && frameIndex < static_cast<int>(fFrameInfos.size())) {
+            // Seed the decode with the cached frame this one depends on, rather than
+            // letting the codec re-decode the whole dependency chain.
+            int required = fFrameInfos[frameIndex].fRequiredFrame;
+            if (required != SkCodec::kNoFrame) {
+                sk_sp<SkImage> prior =
+                        fCache->find(this->keyFor(required), *fData, /*countMiss=*/false);
+                if (prior && prior->readPixels(nullptr, bitmap.pixmap(), 0, 0)) {
+                    options.fPriorFrame = required;
+                }
+            }
+        }
+
+        SkCodec::Result result = fCodec->getPixels(bitmap.pixmap(), &options);
+        if (result != SkCodec::kSuccess && result != SkCodec::kIncompleteInput &&
+            result != SkCodec::kErrorInInput) {
+            return nullptr;
+        }
+        bitmap.setImmutable();
+        sk_sp<SkImage> image = bitmap.asImage();
+        fCache->add(this->keyFor(frameIndex), fData, image);
+        return image;
+    }
+
+    std::mutex                          fCodecMutex;
+    const sk_sp<SkData>                 fData;
+    const std::unique_ptr<SkCodec>      fCodec;
+    const sk_sp<DecodedImageCache>      fCache;
+    const uint64_t                      fContentHash;
+    const size_t                        fContentSize;
+    const std::vector<SkCodec::FrameInfo> fFrameInfos;
+    double                              fTotalDuration = 0;
+};
+
+}  // namespace
+
+sk_sp<CachingImageResourceProvider> CachingImageResourceProvider::Make(
+        sk_sp<skresources::ResourceProvider> rp, sk_sp<DecodedImageCache> cache) {
+    if (!rp || !cache) {
+        return nullptr;
+    }
+    return sk_sp<CachingImageResourceProvider>(
+            new CachingImageResourceProvider(std::move(rp), std::move(cache)));
+}
+
+CachingImageResourceProvider::CachingImageResourceProvider(
+        sk_sp<skresources::ResourceProvider> rp, sk_sp<DecodedImageCache> cache)
+    : ResourceProviderProxyBase(std::move(rp))
+    , fCache(std::move(cache)) {}
+
+sk_sp<skresources::ImageAsset> CachingImageResourceProvider::loadImageAsset(
+        const char resource_path[], const char resource_name[], const char resource_id[]) const {
+    std::string key = std::string(resource_path) + '/' + resource_name;
+
+    {
+        std::lock_guard<std::mutex> lock(fAssetsMutex);
+        if (auto found = fAssets.find(key); found != fAssets.end()) {
+            return found->second;
+        }
+    }
+
+    // Loaded without the lock, so that threads requesting different assets do their file I/O
+    // and codec setup in parallel. Threads racing on the same asset may each load it; the
+    // first one to finish is kept and shared.
+    sk_sp<skresources::ImageAsset> asset;
+    if (sk_sp<SkData> data = fProxy->load(resource_path, resource_name)) {
+        asset = CachedImageAsset::Make(std::move(data), fCache);
+    }
+    if (!asset) {
+        // Not something SkCodec understands (or not loadable as raw bytes); let the
+        // wrapped provider deal with it.
+        asset = fProxy->loadImageAsset(resource_path, resource_name, resource_id);
+    }
+    if (!asset) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(fAssetsMutex);
+    return fAssets.emplace(key, std::move(asset)).first->second;
+}
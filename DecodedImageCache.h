@@ -0,0 +1,115 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DecodedImageCache_DEFINED
+#define DecodedImageCache_DEFINED
+
+#include "include/core/SkData.h"
+#include "include/core/SkImage.h"
+#include "include/core/SkRefCnt.h"
+#include "modules/skresources/include/SkResources.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// A thread-safe LRU cache of decoded frames, keyed by the content of the
+// encoded data (not its path) and the frame index. Two assets with identical
+// bytes share their decoded frames.
+//
+// The key's hash only narrows the search: each entry keeps its encoded data,
+// and a lookup is a hit only if that data equals the caller's byte for byte.
+class DecodedImageCache : public SkRefCnt {
+public:
+    struct Key {
+        uint64_t fContentHash;
+        size_t   fContentSize;
+        int      fFrameIndex;
+
+        bool operator==(const Key& other) const {
+            return fContentHash == other.fContentHash &&
+                   fContentSize == other.fContentSize &&
+                   fFrameIndex == other.fFrameIndex;
+        }
+    };
+
+    struct Stats {
+        int    fHits = 0;
+        int    fMisses = 0;
+        int    fEvictions = 0;
+        size_t fBytes = 0;
+        size_t fBudget = 0;
+    };
+
+    explicit DecodedImageCache(size_t byteBudget) : fBudget(byteBudget) {}
+
+    // Returns the frame cached for key and content, or null. A hit is always
+    // counted; a miss only if countMiss, so that a caller which looks again
+    // before decoding counts one miss per decode.
+    sk_sp<SkImage> find(const Key&, const SkData& content, bool countMiss = true);
+    void add(const Key&, sk_sp<SkData> content, sk_sp<SkImage>);
+
+    void setByteBudget(size_t);
+    Stats stats() const;
+
+    static uint64_t HashContent(const void* data, size_t size);
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return static_cast<size_t>(key.fContentHash ^ (key.fContentSize << 1) ^
+                                       (static_cast<uint64_t>(key.fFrameIndex) << 48));
+        }
+    };
+    struct Entry {
+        Key            fKey;
+        sk_sp<SkData>  fContent;  // encoded bytes; shared with the asset, not budgeted
+        sk_sp<SkImage> fImage;
+        size_t         fBytes;
+    };
+
+    void purgeLocked();
+
+    mutable std::mutex fMutex;
+    size_t             fBudget;
+    size_t             fBytes = 0;
+    // Front is most recently used.
+    std::list<Entry>   fLRU;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> fIndex;
+    Stats              fStats;
+};
+
+// A ResourceProvider proxy which routes image loads through a DecodedImageCache.
+// The wrapped provider is only used to fetch the encoded bytes, once per
+// (path, name); every frame after that is decoded at most once while it stays
+// within the cache budget, no matter how many times or from how many threads it
+// is requested.
+class CachingImageResourceProvider final : public skresources::ResourceProviderProxyBase {
+public:
+    static sk_sp<CachingImageResourceProvider> Make(sk_sp<skresources::ResourceProvider> rp,
+                                                    sk_sp<DecodedImageCache> cache);
+
+    sk_sp<skresources::ImageAsset> loadImageAsset(const char resource_path[],
+                                                  const char resource_name[],
+                                                  const char resource_id[]) const override;
+
+    const sk_sp<DecodedImageCache>& cache() const { return fCache; }
+
+private:
+    CachingImageResourceProvider(sk_sp<skresources::ResourceProvider>, sk_sp<DecodedImageCache>);
+
+    const sk_sp<DecodedImageCache> fCache;
+
+    mutable std::mutex                                                 fAssetsMutex;
+    mutable std::map<std::string, sk_sp<skresources::ImageAsset>>      fAssets;
+};
+
+#endif
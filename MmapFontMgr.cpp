@@ -0,0 +1,377 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "include/core/SkData.h"
+#include "include/core/SkFontArguments.h"
+#include "include/core/SkFontMgr.h"
+#include "include/core/SkFontStyle.h"
+#include "include/core/SkRefCnt.h"
+#include "include/core/SkStream.h"
+#include "include/core/SkString.h"
+#include "include/core/SkTypeface.h"
+#include "include/ports/SkFontMgr_empty.h"
+
+#include "MmapFontMgr.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <utility>
+
+namespace {
+
+// Coverage is recorded for the BMP and the supplementary planes fonts actually use
+// (SMP for emoji and historic scripts, SIP for CJK extensions).
+constexpr SkUnichar kMaxIndexedCodepoint = 0x3FFFF;
+
+// Generic names, and what to try for them, in order.
+const std::map<std::string, std::vector<std::string>> kGenericFamilies = {
+    {"sans-serif", {"roboto", "noto sans", "dejavu sans", "liberation sans", "arial"}},
+    {"serif",      {"noto serif", "dejavu serif", "liberation serif", "times new roman"}},
+    {"monospace",  {"noto sans mono", "dejavu sans mono", "liberation mono", "courier new"}},
+};
+
+std::string lowercase(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return s;
+}
+
+struct Face {
+    std::string                                 fPath;
+    int                                         fIndex;
+    size_t                                      fSize;
+    SkFontStyle                                 fStyle;
+    std::vector<std::pair<SkUnichar, SkUnichar>> fRanges;   // inclusive, sorted
+
+    bool covers(SkUnichar c) const {
+        auto it = std::upper_bound(fRanges.begin(), fRanges.end(), c,
+                                   [](SkUnichar v, const auto& r) { return v < r.first; });
+        return it != fRanges.begin() && c <= std::prev(it)->second;
+    }
+};
+
+struct Family {
+    SkString         fName;
+    std::vector<int> fFaces;
+};
+
+int style_distance(const SkFontStyle& a, const SkFontStyle& b) {
+    return (a.slant() != b.slant() ? 10000 : 0) + 100 * std::abs(a.width() - b.width()) +
+           std::abs(a.weight() - b.weight());
+}
+
+class MmapFontMgr final : public SkFontMgr {
+public:
+    MmapFontMgr(std::vector<Face> faces, std::vector<Family> families)
+            : fFaces(std::move(faces))
+            , fFamilies(std::move(families))
+            , fTypefaces(fFaces.size())
+            , fLoader(SkFontMgr_New_Custom_Empty()) {
+        for (size_t i = 0; i < fFamilies.size(); ++i) {
+            fFamilyByName[lowercase(fFamilies[i].fName.c_str())] = static_cast<int>(i);
+        }
+    }
+
+    const Family& family(int index) const { return fFamilies[index]; }
+    const Face& face(int index) const { return fFaces[index]; }
+
+    // Maps (and on first use, parses) the font file of a face.
+    sk_sp<SkTypeface> typeface(int index) const {
+        std::lock_guard<std::mutex> lock(fMutex);
+        sk_sp<SkTypeface>& typeface = fTypefaces[index];
+        if (!typeface) {
+            const Face& face = fFaces[index];
+            sk_sp<SkData> data = SkData::MakeFromFileName(face.fPath.c_str());
+            if (data && data->size() == face.fSize) {  // a stale index entry would not match
+                typeface = fLoader->makeFromData(std::move(data), face.fIndex);
+            }
+        }
+        return typeface;
+    }
+
+    // Best style in the family, considering only faces for which accept() is true.
+    template <typename Accept>
+    int bestFace(int familyIndex, const SkFontStyle& style, Accept accept) const {
+        int best = -1, bestDistance = 0;
+        for (int f : fFamilies[familyIndex].fFaces) {
+            int distance = style_distance(fFaces[f].fStyle, style);
+            if (accept(fFaces[f]) && (best < 0 || distance < bestDistance)) {
+                best = f;
+                bestDistance = distance;
+            }
+        }
+        return best;
+    }
+
+    // The family with this name, or for a generic or missing name the first installed
+    // preferred family; -1 if there is no such family.
+    int findFamily(const char familyName[]) const {
+        std::string name = lowercase(familyName ? familyName : "");
+        auto found = fFamilyByName.find(name);
+        if (found != fFamilyByName.end()) {
+            return found->second;
+        }
+        auto generic = kGenericFamilies.find(name.empty() ? "sans-serif" : name);
+        if (generic == kGenericFamilies.end()) {
+            return -1;
+        }
+        for (const std::string& candidate : generic->second) {
+            found = fFamilyByName.find(candidate);
+            if (found != fFamilyByName.end()) {
+                return found->second;
+            }
+        }
+        return fFamilies.empty() ? -1 : 0;
+    }
+
+protected:
+    int onCountFamilies() const override { return static_cast<int>(fFamilies.size()); }
+
+    void onGetFamilyName(int index, SkString* familyName) const override {
+        *familyName = fFamilies[index].fName;
+    }
+
+    sk_sp<SkFontStyleSet> onCreateStyleSet(int index) const override;
+
+    sk_sp<SkFontStyleSet> onMatchFamily(const char familyName[]) const override {
+        int family = this->findFamily(familyName);
+        return family < 0 ? nullptr : this->onCreateStyleSet(family);
+    }
+
+    sk_sp<SkTypeface> onMatchFamilyStyle(const char familyName[],
+                                         const SkFontStyle& style) const override {
+        int family = this->findFamily(familyName);
+        if (family < 0) {
+            return nullptr;
+        }
+        int face = this->bestFace(family, style, [](const Face&) { return true; });
+        return face < 0 ? nullptr : this->typeface(face);
+    }
+
+    sk_sp<SkTypeface> onMatchFamilyStyleCharacter(const char familyName[],
+                                                  const SkFontStyle& style,
+                                                  const char*[], int,
+                                                  SkUnichar character) const override {
+        auto covers = [character](const Face& face) { return face.covers(character); };
+        int preferred = this->findFamily(familyName);
+        if (preferred >= 0) {
+            int face = this->bestFace(preferred, style, covers);
+            if (face >= 0) {
+                return this->typeface(face);
+            }
+        }
+        // Fall back to families in index order, which is the order the directories were
+        // given when the index was built.
+        for (int family = 0; family < static_cast<int>(fFamilies.size()); ++family) {
+            int face = this->bestFace(family, style, covers);
+            if (face >= 0) {
+                return this->typeface(face);
+            }
+        }
+        return nullptr;
+    }
+
+    sk_sp<SkTypeface> onLegacyMakeTypeface(const char familyName[],
+                                           SkFontStyle style) const override {
+        sk_sp<SkTypeface> typeface = this->onMatchFamilyStyle(familyName, style);
+        return typeface ? typeface : this->onMatchFamilyStyle(nullptr, style);
+    }
+
+    sk_sp<SkTypeface> onMakeFromData(sk_sp<SkData> data, int ttcIndex) const override {
+        return fLoader->makeFromData(std::move(data), ttcIndex);
+    }
+    sk_sp<SkTypeface> onMakeFromStreamIndex(std::unique_ptr<SkStreamAsset> stream,
+                                            int ttcIndex) const override {
+        return fLoader->makeFromStream(std::move(stream), ttcIndex);
+    }
+    sk_sp<SkTypeface> onMakeFromStreamArgs(std::unique_ptr<SkStreamAsset> stream,
+                                           const SkFontArguments& args) const override {
+        return fLoader->makeFromStream(std::move(stream), args);
+    }
+    sk_sp<SkTypeface> onMakeFromFile(const char path[], int ttcIndex) const override {
+        return fLoader->makeFromFile(path, ttcIndex);
+    }
+
+private:
+    std::vector<Face>                      fFaces;
+    std::vector<Family>                    fFamilies;
+    std::map<std::string, int>             fFamilyByName;   // lowercase name -> family
+
+    mutable std::mutex                     fMutex;
+    mutable std::vector<sk_sp<SkTypeface>> fTypefaces;      // by face, created on demand
+    sk_sp<SkFontMgr>                       fLoader;
+};
+
+class MmapFontStyleSet final : public SkFontStyleSet {
+public:
+    MmapFontStyleSet(sk_sp<const MmapFontMgr> mgr, int family)
+            : fMgr(std::move(mgr)), fFamily(family) {}
+
+    int count() override { return static_cast<int>(this->faces().size()); }
+
+    void getStyle(int index, SkFontStyle* style, SkString* name) override {
+        if (style) {
+            *style = fMgr->face(this->faces()[index]).fStyle;
+        }
+        if (name) {
+            name->reset();
+        }
+    }
+
+    sk_sp<SkTypeface> createTypeface(int index) override {
+        return fMgr->typeface(this->faces()[index]);
+    }
+
+    sk_sp<SkTypeface> matchStyle(const SkFontStyle& pattern) override {
+        return this->matchStyleCSS3(pattern);
+    }
+
+private:
+    const std::vector<int>& faces() const { return fMgr->family(fFamily).fFaces; }
+
+    sk_sp<const MmapFontMgr> fMgr;
+    int                      fFamily;
+};
+
+sk_sp<SkFontStyleSet> MmapFontMgr::onCreateStyleSet(int index) const {
+    return sk_make_sp<MmapFontStyleSet>(sk_ref_sp(this), index);
+}
+
+std::vector<std::pair<SkUnichar, SkUnichar>> coverage(SkTypeface* typeface) {
+    std::vector<std::pair<SkUnichar, SkUnichar>> ranges;
+    constexpr int kChunk = 4096;
+    SkUnichar chars[kChunk];
+    SkGlyphID glyphs[kChunk];
+    bool inRange = false;
+    for (SkUnichar base = 0; base <= kMaxIndexedCodepoint; base += kChunk) {
+        for (int i = 0; i < kChunk; ++i) {
+            chars[i] = base + i;
+        }
+        typeface->unicharsToGlyphs(chars, kChunk, glyphs);
+        for (int i = 0; i < kChunk; ++i) {
+            if (glyphs[i] && !inRange) {
+                ranges.push_back({chars[i], chars[i]});
+                inRange = true;
+            } else if (glyphs[i]) {
+                ranges.back().second = chars[i];
+            } else {
+                inRange = false;
+            }
+        }
+    }
+    return ranges;
+}
+
+}  // namespace
+
+sk_sp<SkFontMgr> MmapFontMgr_New(const char indexPath[]) {
+    sk_sp<SkData> index = SkData::MakeFromFileName(indexPath);
+    if (!index) {
+        return nullptr;
+    }
+    std::vector<Face> faces;
+    std::vector<Family> families;
+    std::map<std::string, int> familyByName;
+
+    std::istringstream lines(std::string(static_cast<const char*>(index->data()),
+                                         index->size()));
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::vector<std::string> fields;
+        std::istringstream columns(line);
+        for (std::string field; std::getline(columns, field, '\t');) {
+            fields.push_back(field);
+        }
+        if (fields.size() < 7) {
+            continue;
+        }
+        Face face;
+        face.fPath = fields[0];
+        face.fIndex = atoi(fields[1].c_str());
+        face.fSize = strtoull(fields[2].c_str(), nullptr, 10);
+        face.fStyle = SkFontStyle(atoi(fields[4].c_str()), atoi(fields[5].c_str()),
+                                  static_cast<SkFontStyle::Slant>(atoi(fields[6].c_str())));
+        if (fields.size() > 7) {
+            std::istringstream ranges(fields[7]);
+            for (std::string range; std::getline(ranges, range, ',');) {
+                char* end;
+                SkUnichar first = strtol(range.c_str(), &end, 16);
+                SkUnichar last = *end == '-' ? strtol(end + 1, nullptr, 16) : first;
+                face.fRanges.push_back({first, last});
+            }
+        }
+
+        auto [it, inserted] = familyByName.insert({fields[3], static_cast<int>(families.size())});
+        if (inserted) {
+            families.push_back({SkString(fields[3].c_str()), {}});
+        }
+        families[it->second].fFaces.push_back(static_cast<int>(faces.size()));
+        faces.push_back(std::move(face));
+    }
+    return sk_make_sp<MmapFontMgr>(std::move(faces), std::move(families));
+}
+
+int MmapFontMgr_BuildIndex(const char indexPath[], const std::vector<std::string>& fontDirs) {
+    std::vector<std::string> paths;
+    for (const std::string& dir : fontDirs) {
+        std::error_code ec;
+        std::vector<std::string> found;
+        for (auto it = std::filesystem::recursive_directory_iterator(dir, ec);
+             !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+            std::string ext = lowercase(it->path().extension().string());
+            if (it->is_regular_file() && (ext == ".ttf" || ext == ".otf" || ext == ".ttc")) {
+                found.push_back(it->path().string());
+            }
+        }
+        std::sort(found.begin(), found.end());   // directory order is not stable
+        paths.insert(paths.end(), found.begin(), found.end());
+    }
+
+    SkFILEWStream out(indexPath);
+    if (!out.isValid()) {
+        return -1;
+    }
+    sk_sp<SkFontMgr> loader = SkFontMgr_New_Custom_Empty();
+    int written = 0;
+    for (const std::string& path : paths) {
+        sk_sp<SkData> data = SkData::MakeFromFileName(path.c_str());
+        if (!data) {
+            continue;
+        }
+        for (int ttcIndex = 0;; ++ttcIndex) {
+            sk_sp<SkTypeface> typeface = loader->makeFromData(data, ttcIndex);
+            if (!typeface) {
+                break;
+            }
+            SkString family;
+            typeface->getFamilyName(&family);
+            SkFontStyle style = typeface->fontStyle();
+            SkString entry = SkStringPrintf("%s\t%d\t%zu\t%s\t%d\t%d\t%d\t", path.c_str(),
+                                            ttcIndex, data->size(), family.c_str(),
+                                            style.weight(), style.width(), (int)style.slant());
+            const char* separator = "";
+            for (const auto& [first, last] : coverage(typeface.get())) {
+                if (first == last) {
+                    entry.appendf("%s%x", separator, first);
+                } else {
+                    entry.appendf("%s%x-%x", separator, first, last);
+                }
+                separator = ",";
+            }
+            entry.append("\n");
+            out.write(entry.c_str(), entry.size());
+            written++;
+        }
+    }
+    return written;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef MmapFontMgr_DEFINED
+#define MmapFontMgr_DEFINED
+
+#include "include/core/SkRefCnt.h"
+
+#include <string>
+#include <vector>
+
+class SkFontMgr;
+
+/**
+ *  A font manager for short-lived processes, which answers matchFamilyStyle() and
+ *  matchFamilyStyleCharacter() from a precomputed index instead of asking fontconfig.
+ *
+ *  The index is a text file with one line per face: file path, collection index, file size,
+ *  family name, weight, width, slant, and the code point ranges covered by its cmap.
+ *  Loading it is a single read and parse; no font file is touched until a typeface is
+ *  first returned, and font files are then memory-mapped (SkData::MakeFromFileName) rather
+ *  than read into memory.
+ *
+ *  Typefaces are created once per face and kept for the lifetime of the manager.
+ */
+sk_sp<SkFontMgr> MmapFontMgr_New(const char indexPath[]);
+
+/**
+ *  Scans the given directories recursively for .ttf, .otf and .ttc files and writes an index
+ *  for MmapFontMgr_New. This is the slow, once-per-installation step. Returns the number of
+ *  faces written, or -1 if the index cannot be written.
+ */
+int MmapFontMgr_BuildIndex(const char indexPath[], const std::vector<std::string>& fontDirs);
+
+#endif
@@ -0,0 +1,388 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "include/core/SkImageInfo.h"
+#include "include/core/SkPixmap.h"
+#include "include/core/SkRect.h"
+#include "include/core/SkStream.h"
+
+#include "ParallelPngEncoder.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t kDictionarySize = 32 * 1024;  // the deflate window
+
+struct Strip {
+    int                  fTop;
+    int                  fBottom;
+    std::vector<uint8_t> fFiltered;     // filter-type byte + row, for every row of the strip
+    uLong                fAdler;
+    std::vector<uint8_t> fCompressed;   // raw deflate data, sync-flushed
+    bool                 fOk = false;
+};
+
+template <typename Fn>
+void parallel_for(int count, int threads, const Fn& fn) {
+    std::atomic<int> next{0};
+    auto worker = [&] {
+        for (int i = next++; i < count; i = next++) {
+            fn(i);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < std::min(threads, count); ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : pool) {
+        t.join();
+    }
+}
+
+uint8_t paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) {
+        return a;
+    }
+    return pb <= pc ? b : c;
+}
+
+// Writes one filtered row (type byte followed by rowBytes) into out. Like libpng's default
+// heuristic, every filter is tried and the one with the smallest sum of absolute (signed)
+// residuals wins.
+void filter_row(const uint8_t* row, const uint8_t* prev, size_t rowBytes, int bpp,
+                uint8_t* out, std::vector<uint8_t>* scratch) {
+    scratch->resize(rowBytes);
+    uint64_t bestSum = UINT64_MAX;
+    for (uint8_t type = 0; type <= 4; ++type) {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < rowBytes; ++i) {
+            int a = i >= (size_t)bpp ? row[i - bpp] : 0;
+            int b = prev ? prev[i] : 0;
+            int c = prev && i >= (size_t)bpp ? prev[i - bpp] : 0;
+            uint8_t predicted = 0;
+            switch (type) {
+                case 0: predicted = 0; break;
+                case 1: predicted = a; break;
+                case 2: predicted = b; break;
+                case 3: predicted = (a + b) >> 1; break;
+                case 4: predicted = paeth(a, b, c); break;
+            }
+            uint8_t residual = row[i] - predicted;
+            (*scratch)[i] = residual;
+            sum += std::abs(static_cast<int8_t>(residual));
+        }
+        if (sum < bestSum) {
+            bestSum = sum;
+            out[0] = type;
+            memcpy(out + 1, scratch->data(), rowBytes);
+        }
+    }
+}
+
+// Converts rows [top, bottom) of src to packed 8-bit RGB(A), in out.
+bool read_rows(const SkPixmap& src, int top, int bottom, int bpp, std::vector<uint8_t>* out) {
+    SkPixmap subset;
+    if (!src.extractSubset(&subset, SkIRect::MakeLTRB(0, top, src.width(), bottom))) {
+        return false;
+    }
+    SkImageInfo info = SkImageInfo::Make(src.width(), bottom - top, kRGBA_8888_SkColorType,
+                                         kUnpremul_SkAlphaType, src.refColorSpace());
+    std::vector<uint8_t> rgba(info.computeMinByteSize());
+    if (!subset.readPixels(info, rgba.data(), info.minRowBytes())) {
+        return false;
+    }
+    if (bpp == 4) {
+        *out = std::move(rgba);
+        return true;
+    }
+    size_t pixels = (size_t)src.width() * (bottom - top);
+    out->resize(pixels * 3);
+    for (size_t i = 0; i < pixels; ++i) {
+        memcpy(out->data() + 3 * i, rgba.data() + 4 * i, 3);
+    }
+    return true;
+}
+
+void filter_strip(const SkPixmap& src, int bpp, Strip* strip) {
+    const size_t rowBytes = (size_t)src.width() * bpp;
+    // The first row of a strip is filtered against the last row of the previous one, which
+    // we convert again here rather than wait for another thread.
+    int firstRow = std::max(0, strip->fTop - 1);
+    std::vector<uint8_t> rows;
+    if (!read_rows(src, firstRow, strip->fBottom, bpp, &rows)) {
+        return;
+    }
+    const uint8_t* prev = strip->fTop > 0 ? rows.data() : nullptr;
+    const uint8_t* row = strip->fTop > 0 ? rows.data() + rowBytes : rows.data();
+
+    strip->fFiltered.resize((rowBytes + 1) * (strip->fBottom - strip->fTop));
+    std::vector<uint8_t> scratch;
+    uint8_t* out = strip->fFiltered.data();
+    for (int y = strip->fTop; y < strip->fBottom; ++y) {
+        filter_row(row, prev, rowBytes, bpp, out, &scratch);
+        prev = row;
+        row += rowBytes;
+        out += rowBytes + 1;
+    }
+    strip->fAdler = adler32(adler32(0L, Z_NULL, 0), strip->fFiltered.data(),
+                            strip->fFiltered.size());
+    strip->fOk = true;
+}
+
+void deflate_strip(const Strip* previous, bool last, int level, Strip* strip) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        strip->fOk = false;
+        return;
+    }
+    if (previous) {
+        const std::vector<uint8_t>& dict = previous->fFiltered;
+        size_t dictSize = std::min(dict.size(), kDictionarySize);
+        deflateSetDictionary(&zs, dict.data() + dict.size() - dictSize, dictSize);
+    }
+
+    strip->fCompressed.resize(deflateBound(&zs, strip->fFiltered.size()) + 16);
+    zs.next_in = strip->fFiltered.data();
+    zs.avail_in = strip->fFiltered.size();
+    zs.next_out = strip->fCompressed.data();
+    zs.avail_out = strip->fCompressed.size();
+
+    // Every strip but the last ends on a byte boundary without a final block, so the
+    // strips can be concatenated into a single deflate stream.
+    const int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+    for (;;) {
+        int ret = deflate(&zs, flush);
+        if (ret == Z_STREAM_ERROR) {
+            strip->fOk = false;
+            break;
+        }
+        if (last ? ret == Z_STREAM_END : (zs.avail_in == 0 && zs.avail_out != 0)) {
+            break;
+        }
+        size_t used = strip->fCompressed.size() - zs.avail_out;
+        strip->fCompressed.resize(strip->fCompressed.size() * 2);
+        zs.next_out = strip->fCompressed.data() + used;
+        zs.avail_out = strip->fCompressed.size() - used;
+    }
+    strip->fCompressed.resize(strip->fCompressed.size() - zs.avail_out);
+    deflateEnd(&zs);
+}
+
+void put_u32(uint8_t* p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+bool write_chunk(SkWStream* dst, const char type[4], const uint8_t* data, size_t size) {
+    uint8_t length[4], crc[4];
+    put_u32(length, static_cast<uint32_t>(size));
+    uLong c = crc32(0L, reinterpret_cast<const Bytef*>(type), 4);
+    if (size > 0) {
+        c = crc32(c, data, size);  // a null buffer would reset the crc instead
+    }
+    put_u32(crc, static_cast<uint32_t>(c));
+    return dst->write(length, 4) && dst->write(type, 4) &&
+           (size == 0 || dst->write(data, size)) && dst->write(crc, 4);
+}
+
+bool write_header(SkWStream* dst, int width, int height, bool opaque) {
+    static const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    if (!dst->write(kSignature, sizeof(kSignature))) {
+        return false;
+    }
+    uint8_t ihdr[13];
+    put_u32(ihdr + 0, width);
+    put_u32(ihdr + 4, height);
+    ihdr[8] = 8;                   // bit depth
+    ihdr[9] = opaque ? 2 : 6;      // truecolor, or truecolor with alpha
+    ihdr[10] = 0;                  // deflate
+    ihdr[11] = 0;                  // adaptive filtering
+    ihdr[12] = 0;                  // no interlace
+    return write_chunk(dst, "IHDR", ihdr, sizeof(ihdr));
+}
+
+}  // namespace
+
+bool ParallelPngEncode(SkWStream* dst, const SkPixmap& src, const ParallelPngOptions& options) {
+    if (!dst || !src.addr() || src.width() <= 0 || src.height() <= 0) {
+        return false;
+    }
+    const bool opaque = src.isOpaque();
+    const int bpp = opaque ? 3 : 4;
+    const size_t rowBytes = (size_t)src.width() * bpp;
+
+    int threads = options.fThreads > 0 ? options.fThreads
+                                       : std::max(1u, std::thread::hardware_concurrency());
+    int rowsPerStrip = options.fRowsPerStrip;
+    if (rowsPerStrip <= 0) {
+        // A few strips per thread for load balancing, but each large enough that the flush
+        // overhead and the lost cross-strip matches are negligible.
+        int byThreads = (src.height() + threads * 4 - 1) / (threads * 4);
+        int byBytes = static_cast<int>((4 * kDictionarySize + rowBytes - 1) / rowBytes);
+        rowsPerStrip = std::max({1, byThreads, byBytes});
+    }
+
+    std::vector<Strip> strips;
+    for (int top = 0; top < src.height(); top += rowsPerStrip) {
+        strips.push_back({top, std::min(src.height(), top + rowsPerStrip), {}, 0, {}});
+    }
+    const int count = static_cast<int>(strips.size());
+
+    parallel_for(count, threads, [&](int i) { filter_strip(src, bpp, &strips[i]); });
+    for (const Strip& strip : strips) {
+        if (!strip.fOk) {
+            return false;
+        }
+    }
+    const int level = std::clamp(options.fZLibLevel, 0, 9);
+    parallel_for(count, threads, [&](int i) {
+        deflate_strip(i > 0 ? &strips[i - 1] : nullptr, i == count - 1, level, &strips[i]);
+    });
+
+    if (!write_header(dst, src.width(), src.height(), opaque)) {
+        return false;
+    }
+
+    // One IDAT per strip. The first carries the zlib header and the last the checksum of
+    // all the uncompressed data, combined from the per-strip checksums.
+    uLong adler = strips[0].fAdler;
+    for (int i = 1; i < count; ++i) {
+        adler = adler32_combine(adler, strips[i].fAdler, strips[i].fFiltered.size());
+    }
+    std::vector<uint8_t> idat;
+    for (int i = 0; i < count; ++i) {
+        if (!strips[i].fOk) {
+            return false;
+        }
+        idat.clear();
+        if (i == 0) {
+            idat.push_back(0x78);
+            idat.push_back(0x9C);
+        }
+        idat.insert(idat.end(), strips[i].fCompressed.begin(), strips[i].fCompressed.end());
+        if (i == count - 1) {
+            uint8_t trailer[4];
+            put_u32(trailer, static_cast<uint32_t>(adler));
+            idat.insert(idat.end(), trailer, trailer + 4);
+        }
+        if (!write_chunk(dst, "IDAT", idat.data(), idat.size())) {
+            return false;
+        }
+    }
+    return write_chunk(dst, "IEND", nullptr, 0);
+}
+
+struct PngStripWriter::Impl {
+    static constexpr size_t kIdatSize = 64 * 1024;
+
+    SkWStream*           fDst;
+    int                  fWidth;
+    int                  fHeight;
+    int                  fBpp;
+    int                  fRowsWritten = 0;
+    bool                 fOk;
+    z_stream             fZ;
+    std::vector<uint8_t> fPrevRow;
+    std::vector<uint8_t> fIdat;
+
+    // Compresses in, writing an IDAT each time the output buffer fills up.
+    bool deflateInto(const uint8_t* in, size_t size, int flush) {
+        fZ.next_in = const_cast<uint8_t*>(in);
+        fZ.avail_in = size;
+        for (;;) {
+            int ret = deflate(&fZ, flush);
+            if (ret == Z_STREAM_ERROR) {
+                return false;
+            }
+            size_t produced = fIdat.size() - fZ.avail_out;
+            bool done = flush == Z_FINISH ? ret == Z_STREAM_END : fZ.avail_in == 0;
+            if (produced > 0 && (fZ.avail_out == 0 || (done && flush == Z_FINISH))) {
+                if (!write_chunk(fDst, "IDAT", fIdat.data(), produced)) {
+                    return false;
+                }
+                fZ.next_out = fIdat.data();
+                fZ.avail_out = fIdat.size();
+            }
+            if (done && fZ.avail_out != 0) {
+                return true;
+            }
+        }
+    }
+};
+
+PngStripWriter::PngStripWriter(SkWStream* dst, int width, int height, bool opaque,
+                               int zlibLevel)
+        : fImpl(new Impl) {
+    Impl& impl = *fImpl;
+    impl.fDst = dst;
+    impl.fWidth = width;
+    impl.fHeight = height;
+    impl.fBpp = opaque ? 3 : 4;
+    memset(&impl.fZ, 0, sizeof(impl.fZ));
+    impl.fOk = dst && width > 0 && height > 0 &&
+               deflateInit(&impl.fZ, std::clamp(zlibLevel, 0, 9)) == Z_OK;
+    if (impl.fOk) {
+        impl.fIdat.resize(Impl::kIdatSize);
+        impl.fZ.next_out = impl.fIdat.data();
+        impl.fZ.avail_out = impl.fIdat.size();
+        impl.fOk = write_header(dst, width, height, opaque);
+    }
+}
+
+PngStripWriter::~PngStripWriter() {
+    deflateEnd(&fImpl->fZ);
+}
+
+bool PngStripWriter::writeRows(const SkPixmap& src) {
+    Impl& impl = *fImpl;
+    if (!impl.fOk || src.width() != impl.fWidth ||
+        impl.fRowsWritten + src.height() > impl.fHeight) {
+        return impl.fOk = false;
+    }
+    const size_t rowBytes = (size_t)impl.fWidth * impl.fBpp;
+    std::vector<uint8_t> rows;
+    if (!read_rows(src, 0, src.height(), impl.fBpp, &rows)) {
+        return impl.fOk = false;
+    }
+    std::vector<uint8_t> filtered((rowBytes + 1) * src.height());
+    std::vector<uint8_t> scratch;
+    const uint8_t* prev = impl.fPrevRow.empty() ? nullptr : impl.fPrevRow.data();
+    for (int y = 0; y < src.height(); ++y) {
+        const uint8_t* row = rows.data() + y * rowBytes;
+        filter_row(row, prev, rowBytes, impl.fBpp, filtered.data() + y * (rowBytes + 1),
+                   &scratch);
+        prev = row;
+    }
+    impl.fPrevRow.assign(prev, prev + rowBytes);
+    impl.fRowsWritten += src.height();
+    return impl.fOk = impl.deflateInto(filtered.data(), filtered.size(), Z_NO_FLUSH);
+}
+
+bool PngStripWriter::finish() {
+    Impl& impl = *fImpl;
+    if (!impl.fOk || impl.fRowsWritten != impl.fHeight ||
+        !impl.deflateInto(nullptr, 0, Z_FINISH)) {
+        return impl.fOk = false;
+    }
+    impl.fOk = false;  // nothing more may be written
+    return write_chunk(impl.fDst, "IEND", nullptr, 0);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef ParallelPngEncoder_DEFINED
+#define ParallelPngEncoder_DEFINED
+
+#include <memory>
+
+class SkPixmap;
+class SkWStream;
+
+struct ParallelPngOptions {
+    // Worker threads; 0 uses one per core.
+    int fThreads = 0;
+    // Rows compressed as one independent deflate block; 0 picks a size from the
+    // image height and thread count.
+    int fRowsPerStrip = 0;
+    // Same meaning as SkPngEncoder::Options::fZLibLevel.
+    int fZLibLevel = 6;
+};
+
+/**
+ *  Encodes src as an 8-bit RGB (opaque sources) or RGBA PNG, splitting the rows into strips
+ *  which are filtered and deflated on separate threads.
+ *
+ *  Like pigz, each strip is ended with a sync flush so the raw deflate streams can simply be
+ *  concatenated, and each strip is primed with the last 32K of its predecessor so the
+ *  compression ratio stays close to a single-threaded encode. The result is one ordinary zlib
+ *  stream split over several IDAT chunks, readable by any PNG decoder including SkPngDecoder.
+ *
+ *  Returns false if src cannot be converted to 8-bit RGBA or compression fails.
+ */
+bool ParallelPngEncode(SkWStream* dst, const SkPixmap& src, const ParallelPngOptions& options);
+
+/**
+ *  Writes a PNG one band of rows at a time, for images that are produced in strips and never
+ *  exist as a whole in memory. Rows are filtered the same way as ParallelPngEncode, and
+ *  compressed as a single stream on the calling thread.
+ *
+ *  Output is 8-bit RGB if opaque is true (alpha is then ignored), RGBA otherwise.
+ */
+class PngStripWriter {
+public:
+    PngStripWriter(SkWStream* dst, int width, int height, bool opaque, int zlibLevel = 6);
+    ~PngStripWriter();
+
+    /** Appends the rows of src, which must be as wide as the image. */
+    bool writeRows(const SkPixmap& src);
+
+    /** Ends the image; fails if fewer rows than the image height were written. */
+    bool finish();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> fImpl;
+};
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "include/codec/SkCodec.h"
+#include "include/core/SkData.h"
+
+#include "PrefetchingResourceProvider.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+using Decoded = PrefetchingResourceProvider::Decoded;
+using Pending = PrefetchingResourceProvider::Pending;
+
+class FutureImageAsset final : public skresources::ImageAsset {
+public:
+    FutureImageAsset(Pending pending, std::shared_ptr<std::atomic<int>> stalls)
+        : fPending(std::move(pending))
+        , fStalls(std::move(stalls)) {}
+
+    bool isMultiFrame() override { return fPending.fMultiFrame.get(); }
+
+    FrameData getFrameData(float t) override {
+        if (fPending.fDecoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            ++*fStalls;
+        }
+        const std::shared_ptr<const Decoded>& decoded = fPending.fDecoded.get();
+        if (!decoded->fAsset) {
+            return {};
+        }
+        if (!this->isMultiFrame()) {
+            return decoded->fFirstFrame;
+        }
+        return decoded->fAsset->getFrameData(t);
+    }
+
+private:
+    const Pending                           fPending;
+    const std::shared_ptr<std::atomic<int>> fStalls;
+};
+
+}  // namespace
+
+sk_sp<PrefetchingResourceProvider> PrefetchingResourceProvider::Make(
+        sk_sp<skresources::ResourceProvider> rp, int threads) {
+    if (!rp) {
+        return nullptr;
+    }
+    return sk_sp<PrefetchingResourceProvider>(
+            new PrefetchingResourceProvider(std::move(rp), threads));
+}
+
+PrefetchingResourceProvider::PrefetchingResourceProvider(sk_sp<skresources::ResourceProvider> rp,
+                                                         int threads)
+    : ResourceProviderProxyBase(std::move(rp))
+    , fExecutor(SkExecutor::MakeFIFOThreadPool(
+              threads > 0 ? threads
+                          : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))))
+    , fStalls(std::make_shared<std::atomic<int>>(0)) {}
+
+void PrefetchingResourceProvider::prefetch(const char resource_path[],
+                                           const char resource_name[]) {
+    this->findOrStart(resource_path, resource_name, "");
+}
+
+void PrefetchingResourceProvider::prefetch(
+        const std::vector<std::pair<std::string, std::string>>& assets) {
+    for (const auto& [path, name] : assets) {
+        this->findOrStart(path.c_str(), name.c_str(), "");
+    }
+}
+
+sk_sp<skresources::ImageAsset> PrefetchingResourceProvider::loadImageAsset(
+        const char resource_path[], const char resource_name[], const char resource_id[]) const {
+    return sk_make_sp<FutureImageAsset>(
+            this->findOrStart(resource_path, resource_name, resource_id), fStalls);
+}
+
+PrefetchingResourceProvider::Pending PrefetchingResourceProvider::findOrStart(
+        const char resource_path[], const char resource_name[], const char resource_id[]) const {
+    std::string key = std::string(resource_path) + '/' + resource_name;
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    if (auto found = fPending.find(key); found != fPending.end()) {
+        return found->second;
+    }
+
+    auto header = std::make_shared<std::promise<bool>>();
+    auto decoded = std::make_shared<std::promise<std::shared_ptr<const Decoded>>>();
+    Pending pending = {header->get_future().share(), decoded->get_future().share()};
+    fPending[key] = pending;
+
+    fExecutor->add([proxy = fProxy,
+                    path = std::string(resource_path),
+                    name = std::string(resource_name),
+                    id = std::string(resource_id ? resource_id : ""),
+                    header,
+                    decoded]() {
+        auto result = std::make_shared<Decoded>();
+
+        std::unique_ptr<SkCodec> codec;
+        if (sk_sp<SkData> data = proxy->load(path.c_str(), name.c_str())) {
+            codec = SkCodec::MakeFromData(std::move(data));
+        }
+        if (codec) {
+            header->set_value(codec->getFrameCount() > 1);
+            result->fAsset = skresources::MultiFrameImageAsset::Make(
+                    std::move(codec), skresources::ImageDecodeStrategy::kPreDecode);
+        } else {
+            // Not raw codec data; the wrapped provider may still know what to do with it.
+            result->fAsset = proxy->loadImageAsset(path.c_str(), name.c_str(), id.c_str());
+            header->set_value(result->fAsset && result->fAsset->isMultiFrame());
+        }
+        if (result->fAsset) {
+            result->fFirstFrame = result->fAsset->getFrameData(0);
+        }
+        decoded->set_value(std::move(result));
+    });
+
+    return pending;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef PrefetchingResourceProvider_DEFINED
+#define PrefetchingResourceProvider_DEFINED
+
+#include "include/core/SkExecutor.h"
+#include "include/core/SkRefCnt.h"
+#include "modules/skresources/include/SkResources.h"
+
+#include <atomic>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A ResourceProvider proxy which decodes images on background threads.
+//
+// Images can be requested up front with prefetch(), or discovered as they are
+// asked for: skottie::Animation::Builder and SkSVGDOM::Builder call
+// loadImageAsset() while parsing, and every such call starts a background decode
+// and returns immediately. The returned ImageAsset only blocks in
+// getFrameData() if the decode has not finished by the time of the first draw.
+class PrefetchingResourceProvider final : public skresources::ResourceProviderProxyBase {
+public:
+    // threads <= 0 uses one thread per core.
+    static sk_sp<PrefetchingResourceProvider> Make(sk_sp<skresources::ResourceProvider> rp,
+                                                   int threads = 0);
+
+    // Starts decoding assets before anybody asks for them.
+    void prefetch(const char resource_path[], const char resource_name[]);
+    void prefetch(const std::vector<std::pair<std::string, std::string>>& assets);
+
+    sk_sp<skresources::ImageAsset> loadImageAsset(const char resource_path[],
+                                                  const char resource_name[],
+                                                  const char resource_id[]) const override;
+
+    // Number of getFrameData() calls that had to wait for a decode in progress.
+    int stalls() const { return fStalls->load(); }
+
+    // The result of a background load: the underlying asset, plus its first frame
+    // already decoded so that static images never decode on the caller's thread.
+    struct Decoded {
+        sk_sp<skresources::ImageAsset>     fAsset;
+        skresources::ImageAsset::FrameData fFirstFrame;
+    };
+
+    // Two stages of the same background load. The header resolves as soon as the
+    // codec has parsed it, so isMultiFrame() (which Skottie queries while building
+    // the scene graph) does not have to wait for pixels.
+    struct Pending {
+        std::shared_future<bool>                           fMultiFrame;
+        std::shared_future<std::shared_ptr<const Decoded>> fDecoded;
+    };
+
+private:
+    PrefetchingResourceProvider(sk_sp<skresources::ResourceProvider>, int threads);
+
+    Pending findOrStart(const char resource_path[], const char resource_name[],
+                        const char resource_id[]) const;
+
+    std::unique_ptr<SkExecutor>       fExecutor;
+    std::shared_ptr<std::atomic<int>> fStalls;
+
+    mutable std::mutex                     fMutex;
+    mutable std::map<std::string, Pending> fPending;
+};
+
+#endif
@@ -0,0 +1,300 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+// Measures SkCodec performance over a directory of images.
+//
+// For every format found in the corpus we time:
+//   header       - SkCodec creation (header parse only)
+//   full         - getPixels() at native size
+//   scaled       - getPixels() at the codec's nearest supported 1/2 scale
+//   scanline     - startScanlineDecode() + getScanlines()
+//   incremental  - startIncrementalDecode() + incrementalDecode()
+// once on a single thread and once on N threads, and print CSV or JSON so the
+// numbers can be compared across Skia revisions. The decode modes create the
+// codec before the clock starts, so they do not include the header parse.
+
+#include "include/codec/SkBmpDecoder.h"
+#include "include/codec/SkCodec.h"
+#include "include/codec/SkEncodedImageFormat.h"
+#include "include/codec/SkGifDecoder.h"
+#include "include/codec/SkIcoDecoder.h"
+#include "include/codec/SkJpegDecoder.h"
+#include "include/codec/SkPngDecoder.h"
+#include "include/codec/SkWbmpDecoder.h"
+#include "include/codec/SkWebpDecoder.h"
+#include "include/core/SkData.h"
+#include "include/core/SkImageInfo.h"
+#include "include/core/SkSize.h"
+#include "include/core/SkStream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+enum class Mode { kHeader, kFull, kScaled, kScanline, kIncremental };
+
+static const Mode kModes[] = {
+    Mode::kHeader, Mode::kFull, Mode::kScaled, Mode::kScanline, Mode::kIncremental,
+};
+
+static const char* mode_name(Mode mode) {
+    switch (mode) {
+        case Mode::kHeader:      return "header";
+        case Mode::kFull:        return "full";
+        case Mode::kScaled:      return "scaled";
+        case Mode::kScanline:    return "scanline";
+        case Mode::kIncremental: return "incremental";
+    }
+    return "";
+}
+
+static const char* format_name(SkEncodedImageFormat format) {
+    switch (format) {
+        case SkEncodedImageFormat::kBMP:  return "bmp";
+        case SkEncodedImageFormat::kGIF:  return "gif";
+        case SkEncodedImageFormat::kICO:  return "ico";
+        case SkEncodedImageFormat::kJPEG: return "jpeg";
+        case SkEncodedImageFormat::kPNG:  return "png";
+        case SkEncodedImageFormat::kWBMP: return "wbmp";
+        case SkEncodedImageFormat::kWEBP: return "webp";
+        default:                          return "other";
+    }
+}
+
+// Runs one operation on one encoded image and reports how long the timed part
+// took. Returns false if the codec does not support the mode for this image, in
+// which case the sample is not counted.
+static bool run_once(Mode mode, const sk_sp<SkData>& data, std::vector<char>* scratch,
+                     size_t* pixelBytes, int64_t* nanos) {
+    *pixelBytes = 0;
+    auto t0 = Clock::now();
+    std::unique_ptr<SkCodec> codec = SkCodec::MakeFromData(data);
+    if (!codec) {
+        return false;
+    }
+    if (mode == Mode::kHeader) {
+        *nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+        return true;
+    }
+
+    SkImageInfo info = codec->getInfo().makeColorType(kN32_SkColorType)
+                                       .makeAlphaType(kPremul_SkAlphaType);
+    if (mode == Mode::kScaled) {
+        SkISize scaled = codec->getScaledDimensions(0.5f);
+        if (scaled == info.dimensions()) {
+            return false;  // This codec cannot scale during decode.
+        }
+        info = info.makeDimensions(scaled);
+    }
+
+    size_t rowBytes = info.minRowBytes();
+    scratch->resize(info.computeByteSize(rowBytes));
+    void* pixels = scratch->data();
+
+    t0 = Clock::now();
+    switch (mode) {
+        case Mode::kHeader:
+            break;
+        case Mode::kFull:
+        case Mode::kScaled:
+            if (codec->getPixels(info, pixels, rowBytes) != SkCodec::kSuccess) {
+                return false;
+            }
+            break;
+        case Mode::kScanline:
+            if (codec->startScanlineDecode(info) != SkCodec::kSuccess ||
+                codec->getScanlineOrder() != SkCodec::kTopDown_SkScanlineOrder ||
+                codec->getScanlines(pixels, info.height(), rowBytes) != info.height()) {
+                return false;
+            }
+            break;
+        case Mode::kIncremental:
+            if (codec->startIncrementalDecode(info, pixels, rowBytes) != SkCodec::kSuccess ||
+                codec->incrementalDecode() != SkCodec::kSuccess) {
+                return false;
+            }
+            break;
+    }
+    *nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+    *pixelBytes = info.computeByteSize(rowBytes);
+    return true;
+}
+
+struct Result {
+    std::string fFormat;
+    Mode        fMode;
+    int         fThreads;
+    int         fFiles;        // images that supported this mode
+    int         fOps;          // operations timed (files * iterations)
+    double      fWallSeconds;
+    double      fOpSeconds;    // sum of successful per-operation time, across all threads
+    double      fPixelBytes;   // decoded bytes produced
+
+    double latencyMs() const { return fOps ? 1000.0 * fOpSeconds / fOps : 0; }
+    // Throughput of all threads together, from the time spent in successful
+    // operations only (wall time also covers unsupported attempts and setup).
+    double megabytesPerSecond() const {
+        return fOpSeconds > 0 ? fPixelBytes / (1024.0 * 1024.0) / (fOpSeconds / fThreads) : 0;
+    }
+};
+
+static Result measure(const std::string& format, const std::vector<sk_sp<SkData>>& files,
+                      Mode mode, int threads, int iterations) {
+    std::atomic<int> next{0};
+    std::atomic<int> supported{0};
+    std::atomic<int> ops{0};
+    std::atomic<int64_t> opNanos{0};
+    std::atomic<int64_t> pixelBytes{0};
+
+    const int work = static_cast<int>(files.size()) * iterations;
+    auto worker = [&] {
+        std::vector<char> scratch;
+        int64_t localNanos = 0;
+        int64_t localBytes = 0;
+        int localOps = 0;
+        for (int i = next++; i < work; i = next++) {
+            const sk_sp<SkData>& data = files[i % files.size()];
+            size_t bytes = 0;
+            int64_t nanos = 0;
+            if (!run_once(mode, data, &scratch, &bytes, &nanos)) {
+                continue;
+            }
+            if (i < static_cast<int>(files.size())) {
+                supported++;
+            }
+            localNanos += nanos;
+            localBytes += bytes;
+            localOps++;
+        }
+        opNanos += localNanos;
+        pixelBytes += localBytes;
+        ops += localOps;
+    };
+
+    auto start = Clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : pool) {
+        t.join();
+    }
+    double wall = std::chrono::duration<double>(Clock::now() - start).count();
+
+    return {format, mode, threads, supported.load(), ops.load(), wall,
+            opNanos.load() * 1e-9, static_cast<double>(pixelBytes.load())};
+}
+
+static void print_csv(const std::vector<Result>& results) {
+    printf("format,mode,threads,files,ops,wall_s,latency_ms,MB_per_s\n");
+    for (const Result& r : results) {
+        printf("%s,%s,%d,%d,%d,%.6f,%.4f,%.2f\n", r.fFormat.c_str(), mode_name(r.fMode),
+               r.fThreads, r.fFiles, r.fOps, r.fWallSeconds, r.latencyMs(),
+               r.megabytesPerSecond());
+    }
+}
+
+static void print_json(const std::vector<Result>& results) {
+    printf("[\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        printf("  {\"format\": \"%s\", \"mode\": \"%s\", \"threads\": %d, \"files\": %d, "
+               "\"ops\": %d, \"wall_s\": %.6f, \"latency_ms\": %.4f, \"MB_per_s\": %.2f}%s\n",
+               r.fFormat.c_str(), mode_name(r.fMode), r.fThreads, r.fFiles, r.fOps,
+               r.fWallSeconds, r.latencyMs(), r.megabytesPerSecond(),
+               i + 1 < results.size() ? "," : "");
+    }
+    printf("]\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s <corpus dir> [--threads N] [--iterations N] [--json]\n", argv[0]);
+        return 1;
+    }
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    int iterations = 3;
+    bool json = false;
+    for (int i = 2; i < argc; ++i) {
+        if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--iterations") && i + 1 < argc) {
+            iterations = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--json")) {
+            json = true;
+        } else {
+            printf("Unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    SkCodecs::Register(SkBmpDecoder::Decoder());
+    SkCodecs::Register(SkGifDecoder::Decoder());
+    SkCodecs::Register(SkIcoDecoder::Decoder());
+    SkCodecs::Register(SkJpegDecoder::Decoder());
+    SkCodecs::Register(SkPngDecoder::Decoder());
+    SkCodecs::Register(SkWbmpDecoder::Decoder());
+    SkCodecs::Register(SkWebpDecoder::Decoder());
+
+    // Read everything up front so that file I/O is not part of any measurement.
+    std::map<std::string, std::vector<sk_sp<SkData>>> corpus;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(argv[1], ec)) {
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+        sk_sp<SkData> data = SkData::MakeFromFileName(entry.path().c_str());
+        if (!data) {
+            continue;
+        }
+        std::unique_ptr<SkCodec> codec = SkCodec::MakeFromData(data);
+        if (!codec) {
+            continue;
+        }
+        corpus[format_name(codec->getEncodedFormat())].push_back(std::move(data));
+    }
+    if (corpus.empty()) {
+        printf("No decodable images found in %s\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<int> threadCounts = {1};
+    if (threads > 1) {
+        threadCounts.push_back(threads);
+    }
+
+    std::vector<Result> results;
+    for (const auto& [format, files] : corpus) {
+        for (Mode mode : kModes) {
+            for (int n : threadCounts) {
+                Result r = measure(format, files, mode, n, iterations);
+                if (r.fOps > 0) {
+                    results.push_back(r);
+                }
+            }
+        }
+    }
+
+    if (json) {
+        print_json(results);
+    } else {
+        print_csv(results);
+    }
+    return 0;
+}
@@ -0,0 +1,358 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+// Sweeps SkPngEncoder, SkJpegEncoder and SkWebpEncoder options over a few representative
+// surfaces - plain text (as in write_text_to_png), vector art (as in svg_renderer) and a
+// shaped paragraph (as in shape_text) - and prints encode time against output size.
+//
+// Every output is decoded again and compared with the source pixels (PSNR). For each format,
+// with lossy and lossless WebP ranked separately, it then suggests a "small" profile (smallest
+// output) and a "fast" profile (quickest setting whose output is within 25% of the smallest),
+// summed over all surfaces. Only settings whose PSNR on every surface reaches the floor
+// (default 40 dB, or the first argument) are considered, so the lowest qualities do not win
+// just by being small.
+
+#include "include/codec/SkCodec.h"
+#include "include/codec/SkJpegDecoder.h"
+#include "include/codec/SkPngDecoder.h"
+#include "include/codec/SkWebpDecoder.h"
+#include "include/core/SkAlphaType.h"
+#include "include/core/SkBitmap.h"
+#include "include/core/SkCanvas.h"
+#include "include/core/SkColor.h"
+#include "include/core/SkData.h"
+#include "include/core/SkFont.h"
+#include "include/core/SkFontMgr.h"
+#include "include/core/SkFontStyle.h"
+#include "include/core/SkImageInfo.h"
+#include "include/core/SkPaint.h"
+#include "include/core/SkPixmap.h"
+#include "include/core/SkRefCnt.h"
+#include "include/core/SkSize.h"
+#include "include/core/SkStream.h"
+#include "include/core/SkString.h"
+#include "include/core/SkSurface.h"
+#include "include/core/SkTypeface.h"
+#include "include/encode/SkJpegEncoder.h"
+#include "include/encode/SkPngEncoder.h"
+#include "include/encode/SkWebpEncoder.h"
+#include "modules/skparagraph/include/FontCollection.h"
+#include "modules/skparagraph/include/Paragraph.h"
+#include "modules/skparagraph/include/ParagraphBuilder.h"
+#include "modules/skparagraph/include/ParagraphStyle.h"
+#include "modules/skshaper/utils/FactoryHelpers.h"
+#include "modules/skunicode/include/SkUnicode_icu.h"
+#include "modules/svg/include/SkSVGDOM.h"
+
+#if defined(SK_FONTMGR_FONTCONFIG_AVAILABLE)
+#include "include/ports/SkFontMgr_fontconfig.h"
+#endif
+
+#if defined(SK_FONTMGR_CORETEXT_AVAILABLE)
+#include "include/ports/SkFontMgr_mac_ct.h"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kRepetitions = 3;
+constexpr double kDefaultMinPsnrDb = 40;
+
+const char* kSvg = "<svg viewBox=\"0 0 150 40\" xmlns=\"http://www.w3.org/2000/svg\">"
+  "<defs><linearGradient id=\"g\"><stop offset=\"0\" stop-color=\"#39f\"/>"
+  "<stop offset=\"1\" stop-color=\"#f93\"/></linearGradient></defs>"
+  "<rect width=\"150\" height=\"40\" fill=\"url(#g)\"/>"
+  "<circle cx=\"20\" cy=\"20\" r=\"14\" fill=\"#fff\" stroke=\"#333\"/>"
+  "<path d=\"M40 30 Q60 0 80 30 T120 30\" fill=\"none\" stroke=\"#222\" stroke-width=\"2\"/>"
+  "<text x=\"90\" y=\"15\" style=\"font: 9px sans-serif\">VAVAVA</text>"
+"</svg>";
+
+const char* kStory =
+    "The landing port at Titan had not changed much in five years.\n"
+    "The ship settled down on the scarred blast shield, beside the same trio "
+    "of squat square buildings, and quickly disgorged its scanty quota of "
+    "cargo and a lone passenger into the flexible tube that linked the loading "
+    "hatch with the main building.";
+
+struct Surface {
+    const char*      fName;
+    sk_sp<SkSurface> fSurface;
+};
+
+static sk_sp<SkSurface> render_text(sk_sp<SkTypeface> face) {
+    auto surface = SkSurfaces::Raster(SkImageInfo::MakeN32(800, 400, kOpaque_SkAlphaType));
+    SkCanvas* canvas = surface->getCanvas();
+    canvas->clear(SK_ColorYELLOW);
+    SkPaint paint;
+    paint.setColor(SK_ColorGREEN);
+    paint.setAntiAlias(true);
+    SkFont font(face, 28);
+    for (int i = 0; i < 10; ++i) {
+        canvas->drawString("Hello world! 0123456789", 10, 40 + 36 * i, font, paint);
+    }
+    return surface;
+}
+
+static sk_sp<SkSurface> render_svg(sk_sp<SkFontMgr> fontMgr) {
+    SkMemoryStream stream(kSvg, strlen(kSvg));
+    auto dom = SkSVGDOM::Builder()
+                       .setFontManager(fontMgr)
+                       .setTextShapingFactory(SkShapers::BestAvailable())
+                       .make(stream);
+    if (!dom) {
+        return nullptr;
+    }
+    auto surface = SkSurfaces::Raster(SkImageInfo::MakeN32Premul(1200, 320));
+    dom->setContainerSize(SkSize::Make(1200, 320));
+    dom->render(surface->getCanvas());
+    return surface;
+}
+
+static sk_sp<SkSurface> render_paragraph(sk_sp<SkFontMgr> fontMgr) {
+    sk_sp<SkUnicode> unicode = SkUnicodes::ICU::Make();
+    if (!unicode) {
+        return nullptr;
+    }
+    auto fontCollection = sk_make_sp<skia::textlayout::FontCollection>();
+    fontCollection->setDefaultFontManager(fontMgr);
+
+    constexpr int width = 600;
+    auto surface = SkSurfaces::Raster(SkImageInfo::MakeN32(width, 400, kOpaque_SkAlphaType));
+    surface->getCanvas()->clear(SK_ColorWHITE);
+
+    SkPaint paint;
+    paint.setAntiAlias(true);
+    paint.setColor(SK_ColorBLACK);
+    skia::textlayout::TextStyle style;
+    style.setForegroundColor(paint);
+    style.setFontFamilies({SkString("sans-serif")});
+    style.setFontSize(18);
+    skia::textlayout::ParagraphStyle paraStyle;
+    paraStyle.setTextStyle(style);
+
+    auto builder = skia::textlayout::ParagraphBuilder::make(paraStyle, fontCollection, unicode);
+    builder->addText(kStory);
+    auto paragraph = builder->Build();
+    paragraph->layout(width - 20);
+    paragraph->paint(surface->getCanvas(), 10, 10);
+    return surface;
+}
+
+// PSNR in dB of the decoded output against the source, over all four 8-bit channels. Returns
+// infinity for an exact match and NaN if the output cannot be decoded.
+static double psnr(const SkPixmap& src, sk_sp<SkData> encoded) {
+    std::unique_ptr<SkCodec> codec = SkCodec::MakeFromData(std::move(encoded));
+    SkBitmap decoded;
+    if (!codec || !decoded.tryAllocPixels(src.info()) ||
+        codec->getPixels(decoded.pixmap()) != SkCodec::kSuccess) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    double sumSquares = 0;
+    for (int y = 0; y < src.height(); ++y) {
+        const uint8_t* a = static_cast<const uint8_t*>(src.addr(0, y));
+        const uint8_t* b = static_cast<const uint8_t*>(decoded.getAddr(0, y));
+        for (size_t i = 0; i < src.info().minRowBytes(); ++i) {
+            double d = double(a[i]) - double(b[i]);
+            sumSquares += d * d;
+        }
+    }
+    if (sumSquares == 0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    double mse = sumSquares / (double(src.info().minRowBytes()) * src.height());
+    return 10 * std::log10(255.0 * 255.0 / mse);
+}
+
+struct Setting {
+    std::string                                          fFormat;
+    std::string                                          fLabel;
+    std::function<bool(SkWStream*, const SkPixmap&)>     fEncode;
+};
+
+static std::vector<Setting> make_settings() {
+    std::vector<Setting> settings;
+
+    const struct { const char* name; SkPngEncoder::FilterFlag flags; } kFilters[] = {
+        {"none",  SkPngEncoder::FilterFlag::kNone},
+        {"sub",   SkPngEncoder::FilterFlag::kSub},
+        {"up",    SkPngEncoder::FilterFlag::kUp},
+        {"paeth", SkPngEncoder::FilterFlag::kPaeth},
+        {"all",   SkPngEncoder::FilterFlag::kAll},
+    };
+    for (int level : {1, 3, 6, 9}) {
+        for (const auto& filter : kFilters) {
+            SkPngEncoder::Options options;
+            options.fZLibLevel = level;
+            options.fFilterFlags = filter.flags;
+            settings.push_back({"png", SkStringPrintf("zlib=%d filter=%s", level, filter.name)
+                                               .c_str(),
+                                [options](SkWStream* dst, const SkPixmap& src) {
+                                    return SkPngEncoder::Encode(dst, src, options);
+                                }});
+        }
+    }
+
+    const struct { const char* name; SkJpegEncoder::Downsample mode; } kDownsample[] = {
+        {"420", SkJpegEncoder::Downsample::k420},
+        {"422", SkJpegEncoder::Downsample::k422},
+        {"444", SkJpegEncoder::Downsample::k444},
+    };
+    for (int quality : {60, 75, 85, 95}) {
+        for (const auto& downsample : kDownsample) {
+            SkJpegEncoder::Options options;
+            options.fQuality = quality;
+            options.fDownsample = downsample.mode;
+            settings.push_back({"jpeg", SkStringPrintf("q=%d %s", quality, downsample.name)
+                                                .c_str(),
+                                [options](SkWStream* dst, const SkPixmap& src) {
+                                    return SkJpegEncoder::Encode(dst, src, options);
+                                }});
+        }
+    }
+
+    // SkWebpEncoder does not expose libwebp's "method" directly. For lossless output
+    // fQuality selects the compression effort, which is the closest equivalent.
+    for (auto compression : {SkWebpEncoder::Compression::kLossy,
+                             SkWebpEncoder::Compression::kLossless}) {
+        bool lossy = compression == SkWebpEncoder::Compression::kLossy;
+        for (float quality : {25.f, 50.f, 75.f, 100.f}) {
+            SkWebpEncoder::Options options;
+            options.fCompression = compression;
+            options.fQuality = quality;
+            // Lossy and lossless WebP answer different questions, so they are ranked apart.
+            settings.push_back({lossy ? "webp-lossy" : "webp-lossless",
+                                SkStringPrintf("%s=%g", lossy ? "q" : "effort", quality).c_str(),
+                                [options](SkWStream* dst, const SkPixmap& src) {
+                                    return SkWebpEncoder::Encode(dst, src, options);
+                                }});
+        }
+    }
+    return settings;
+}
+
+struct Totals {
+    double fMs = 0;
+    size_t fBytes = 0;
+    double fMinPsnr = std::numeric_limits<double>::infinity();
+    bool   fOk = true;
+};
+
+int main(int argc, char** argv) {
+    if (argc > 2) {
+        printf("Usage: %s [min PSNR in dB, default %g]\n", argv[0], kDefaultMinPsnrDb);
+        return 1;
+    }
+    double minPsnr = argc > 1 ? atof(argv[1]) : kDefaultMinPsnrDb;
+    if (minPsnr <= 0) {
+        printf("Invalid PSNR floor %s\n", argv[1]);
+        return 1;
+    }
+    SkCodecs::Register(SkJpegDecoder::Decoder());
+    SkCodecs::Register(SkPngDecoder::Decoder());
+    SkCodecs::Register(SkWebpDecoder::Decoder());
+
+    sk_sp<SkFontMgr> fontMgr;
+#if defined(SK_FONTMGR_FONTCONFIG_AVAILABLE)
+    fontMgr = SkFontMgr_New_FontConfig(nullptr);
+#elif defined(SK_FONTMGR_CORETEXT_AVAILABLE)
+    fontMgr = SkFontMgr_New_CoreText(nullptr);
+#endif
+    if (!fontMgr) {
+        printf("No Font Manager configured\n");
+        return 1;
+    }
+    sk_sp<SkTypeface> face = fontMgr->matchFamilyStyle("Roboto", SkFontStyle());
+    if (!face) {
+        face = fontMgr->legacyMakeTypeface(nullptr, SkFontStyle());
+    }
+
+    std::vector<Surface> surfaces = {
+        {"text", render_text(face)},
+        {"vector", render_svg(fontMgr)},
+        {"paragraph", render_paragraph(fontMgr)},
+    };
+
+    std::vector<Setting> settings = make_settings();
+    std::map<std::string, Totals> totals;  // keyed by format + label
+
+    printf("surface,format,setting,encode_ms,bytes,psnr_db\n");
+    for (const Surface& s : surfaces) {
+        SkPixmap pixmap;
+        if (!s.fSurface || !s.fSurface->peekPixels(&pixmap)) {
+            printf("# could not render %s surface, skipping\n", s.fName);
+            continue;
+        }
+        for (const Setting& setting : settings) {
+            double bestMs = 0;
+            size_t bytes = 0;
+            bool ok = true;
+            sk_sp<SkData> encoded;
+            for (int rep = 0; rep < kRepetitions; ++rep) {
+                SkDynamicMemoryWStream stream;
+                auto t0 = Clock::now();
+                ok &= setting.fEncode(&stream, pixmap);
+                double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+                bestMs = rep == 0 ? ms : std::min(bestMs, ms);
+                bytes = stream.bytesWritten();
+                encoded = stream.detachAsData();
+            }
+            double db = ok ? psnr(pixmap, encoded) : std::numeric_limits<double>::quiet_NaN();
+            printf("%s,%s,%s,%.3f,%zu,%.2f\n", s.fName, setting.fFormat.c_str(),
+                   setting.fLabel.c_str(), bestMs, bytes, db);
+            Totals& t = totals[setting.fFormat + "\t" + setting.fLabel];
+            t.fMs += bestMs;
+            t.fBytes += bytes;
+            t.fOk &= ok && !std::isnan(db);
+            t.fMinPsnr = std::min(t.fMinPsnr, db);
+        }
+    }
+
+    printf("\n# Suggested profiles (summed over all surfaces, PSNR >= %g dB)\n", minPsnr);
+    for (const char* format : {"png", "jpeg", "webp-lossy", "webp-lossless"}) {
+        std::string prefix = std::string(format) + "\t";
+        auto eligible = [&](const std::pair<const std::string, Totals>& entry) {
+            return entry.first.rfind(prefix, 0) == 0 && entry.second.fOk &&
+                   entry.second.fMinPsnr >= minPsnr;
+        };
+        const std::pair<const std::string, Totals>* smallest = nullptr;
+        for (const auto& entry : totals) {
+            if (eligible(entry) && (!smallest || entry.second.fBytes < smallest->second.fBytes)) {
+                smallest = &entry;
+            }
+        }
+        if (!smallest) {
+            printf("# %-13s no setting reaches %g dB on every surface\n", format, minPsnr);
+            continue;
+        }
+        const std::pair<const std::string, Totals>* fastest = nullptr;
+        for (const auto& entry : totals) {
+            if (eligible(entry) && entry.second.fBytes <= smallest->second.fBytes * 5 / 4 &&
+                (!fastest || entry.second.fMs < fastest->second.fMs)) {
+                fastest = &entry;
+            }
+        }
+        for (auto [kind, entry] : {std::make_pair("fast: ", fastest),
+                                   std::make_pair("small:", smallest)}) {
+            printf("# %-13s %s %-24s %8.2f ms %9zu bytes %7.2f dB\n", format, kind,
+                   entry->first.substr(prefix.size()).c_str(), entry->second.fMs,
+                   entry->second.fBytes, entry->second.fMinPsnr);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+// Measures the font setup cost of a short-lived render process.
+//
+// Each run forks a fresh child, which creates a font manager, resolves "Roboto" (the
+// samples' usual choice) and a fallback for a CJK character, and measures a string so
+// the typeface is actually loaded. Three ways are compared:
+//
+//   fontconfig  SkFontMgr_New_FontConfig, as write_text_to_png.cpp and svg_renderer.cpp do;
+//   stream      reading the whole font file through SkData::MakeFromStream into an empty
+//               custom font manager, as shape_text.cpp does (no fallback);
+//   mmap        MmapFontMgr, from an index built beforehand with --build.
+
+#include "include/core/SkData.h"
+#include "include/core/SkFont.h"
+#include "include/core/SkFontMgr.h"
+#include "include/core/SkFontStyle.h"
+#include "include/core/SkRefCnt.h"
+#include "include/core/SkStream.h"
+#include "include/core/SkString.h"
+#include "include/core/SkTypeface.h"
+#include "include/ports/SkFontMgr_empty.h"
+
+#if defined(SK_FONTMGR_FONTCONFIG_AVAILABLE)
+#include "include/ports/SkFontMgr_fontconfig.h"
+#endif
+
+#include "MmapFontMgr.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+constexpr SkUnichar kFallbackChar = 0x4E2D;  // 中
+
+// Resolves the typefaces a sample would need; returns false if Roboto (or a default)
+// cannot be found.
+static bool resolve(const sk_sp<SkFontMgr>& mgr, bool fallback) {
+    sk_sp<SkTypeface> face = mgr->matchFamilyStyle("Roboto", SkFontStyle());
+    if (!face) {
+        face = mgr->legacyMakeTypeface(nullptr, SkFontStyle());
+    }
+    if (!face) {
+        return false;
+    }
+    SkFont font(face, 14);
+    if (font.measureText("Hello world!", 12, SkTextEncoding::kUTF8) <= 0) {
+        return false;
+    }
+    if (fallback) {
+        mgr->matchFamilyStyleCharacter(nullptr, SkFontStyle(), nullptr, 0, kFallbackChar);
+    }
+    return true;
+}
+
+// Runs fn in a forked child and returns {ms measured inside the child, wall ms including
+// process creation and teardown}, or negative values on failure.
+static std::pair<double, double> run_cold(const std::function<bool()>& fn) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return {-1, -1};
+    }
+    auto t0 = Clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        auto start = Clock::now();
+        double ms = fn() ? std::chrono::duration<double, std::milli>(Clock::now() - start).count()
+                         : -1;
+        ssize_t unused = write(fds[1], &ms, sizeof(ms));
+        (void)unused;
+        _exit(0);
+    }
+    close(fds[1]);
+    double ms = -1;
+    if (pid < 0 || read(fds[0], &ms, sizeof(ms)) != sizeof(ms)) {
+        ms = -1;
+    }
+    close(fds[0]);
+    if (pid > 0) {
+        waitpid(pid, nullptr, 0);
+    }
+    return {ms, std::chrono::duration<double, std::milli>(Clock::now() - t0).count()};
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 4 && !strcmp(argv[2], "--build")) {
+        std::vector<std::string> dirs(argv + 3, argv + argc);
+        auto t0 = Clock::now();
+        int faces = MmapFontMgr_BuildIndex(argv[1], dirs);
+        if (faces < 0) {
+            printf("Cannot write index %s\n", argv[1]);
+            return 1;
+        }
+        printf("Indexed %d faces in %.1f ms\n", faces,
+               std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+        return 0;
+    }
+    if (argc < 2 || argc > 3) {
+        printf("Usage: %s <index> --build <font dir> ...\n"
+               "       %s <index> [runs]\n", argv[0], argv[0]);
+        return 1;
+    }
+    const char* indexPath = argv[1];
+    int runs = argc > 2 ? atoi(argv[2]) : 10;
+    if (runs <= 0) {
+        printf("Invalid run count %s\n", argv[2]);
+        return 1;
+    }
+
+    // The file that "Roboto" resolves to, for the shape_text.cpp style of loading.
+    std::string robotoPath;
+    if (sk_sp<SkData> index = SkData::MakeFromFileName(indexPath)) {
+        std::string text(static_cast<const char*>(index->data()), index->size());
+        for (size_t pos = 0; pos < text.size();) {
+            size_t end = std::min(text.find('\n', pos), text.size());
+            std::string line = text.substr(pos, end - pos);
+            size_t tab = line.find('\t');
+            if (robotoPath.empty() && line.find("\tRoboto\t400\t") != std::string::npos) {
+                robotoPath = line.substr(0, tab);
+            }
+            pos = end + 1;
+        }
+    } else {
+        printf("Cannot read index %s; build it with --build first\n", indexPath);
+        return 1;
+    }
+
+    struct Mode {
+        const char*           fName;
+        std::function<bool()> fRun;
+    };
+    std::vector<Mode> modes;
+#if defined(SK_FONTMGR_FONTCONFIG_AVAILABLE)
+    modes.push_back({"fontconfig", [] {
+        return resolve(SkFontMgr_New_FontConfig(nullptr), /*fallback=*/true);
+    }});
+#endif
+    if (!robotoPath.empty()) {
+        modes.push_back({"stream", [&robotoPath] {
+            SkFILEStream input(robotoPath.c_str());
+            sk_sp<SkData> data = SkData::MakeFromStream(&input, input.getLength());
+            sk_sp<SkTypeface> face = SkFontMgr_New_Custom_Empty()->makeFromData(data);
+            return face && SkFont(face, 14).measureText("Hello world!", 12,
+                                                        SkTextEncoding::kUTF8) > 0;
+        }});
+    }
+    modes.push_back({"mmap", [indexPath] {
+        sk_sp<SkFontMgr> mgr = MmapFontMgr_New(indexPath);
+        return mgr && resolve(mgr, /*fallback=*/true);
+    }});
+
+    printf("%-11s %12s %12s   (median of %d cold processes)\n", "", "in-process", "wall", runs);
+    for (const Mode& mode : modes) {
+        std::vector<double> inside, wall;
+        for (int i = 0; i < runs; ++i) {
+            auto [ms, wallMs] = run_cold(mode.fRun);
+            if (ms < 0) {
+                break;
+            }
+            inside.push_back(ms);
+            wall.push_back(wallMs);
+        }
+        if (inside.empty()) {
+            printf("%-11s failed\n", mode.fName);
+            continue;
+        }
+        std::sort(inside.begin(), inside.end());
+        std::sort(wall.begin(), wall.end());
+        printf("%-11s %9.2f ms %9.2f ms\n", mode.fName, inside[inside.size() / 2],
+               wall[wall.size() / 2]);
+    }
+    return 0;
+}
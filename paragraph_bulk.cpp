@@ -0,0 +1,193 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+// Lays out thousands of paragraphs with BulkParagraphLayout at increasing thread counts,
+// and checks that every multithreaded run produces exactly the same glyphs and positions
+// as the single-threaded one. Optionally paints the first paragraphs into a JPEG, as
+// shape_text.cpp does, to show the blobs being drawn serially.
+
+#include "include/core/SkAlphaType.h"
+#include "include/core/SkCanvas.h"
+#include "include/core/SkColor.h"
+#include "include/core/SkData.h"
+#include "include/core/SkFontMgr.h"
+#include "include/core/SkImageInfo.h"
+#include "include/core/SkPaint.h"
+#include "include/core/SkPixmap.h"
+#include "include/core/SkRefCnt.h"
+#include "include/core/SkSerialProcs.h"
+#include "include/core/SkStream.h"
+#include "include/core/SkString.h"
+#include "include/core/SkSurface.h"
+#include "include/core/SkTextBlob.h"
+#include "include/core/SkTypeface.h"
+#include "include/encode/SkJpegEncoder.h"
+#include "include/ports/SkFontMgr_empty.h"
+#include "modules/skparagraph/include/ParagraphStyle.h"
+
+#include "BulkParagraphLayout.h"
+#include "OneFontMgr.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// https://www.gutenberg.org/ebooks/72339
+constexpr const char* sentences[] = {
+    "The landing port at Titan had not changed much in five years.",
+    "The ship settled down on the scarred blast shield, beside the same trio "
+    "of squat square buildings.",
+    "It quickly disgorged its scanty quota of cargo and a lone passenger into "
+    "the flexible tube that linked the loading hatch with the main building.",
+    "As soon as the tube was disconnected, the ship screamed off through the "
+    "murky atmosphere.",
+    "It seemed glad to get away from Titan and head back to the more "
+    "comfortable and settled parts of the Solar System.",
+};
+
+static std::vector<std::string> make_paragraphs(int count) {
+  std::vector<std::string> paragraphs;
+  for (int i = 0; i < count; ++i) {
+    std::string text = "Record " + std::to_string(i) + ".";
+    int n = 1 + i % 4;
+    for (int s = 0; s < n; ++s) {
+      text += " ";
+      text += sentences[(i + s) % std::size(sentences)];
+    }
+    paragraphs.push_back(std::move(text));
+  }
+  return paragraphs;
+}
+
+static bool same_layout(const std::vector<LaidOutParagraph>& a,
+                        const std::vector<LaidOutParagraph>& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (!a[i].blob || !b[i].blob || a[i].height != b[i].height) {
+      return false;
+    }
+    sk_sp<SkData> da = a[i].blob->serialize(SkSerialProcs());
+    sk_sp<SkData> db = b[i].blob->serialize(SkSerialProcs());
+    if (!da || !db || !da->equals(db.get())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 4) {
+    printf("Usage: %s <font.ttf> [paragraphs] [name.jpg]\n", argv[0]);
+    return 1;
+  }
+
+  SkFILEStream input(argv[1]);
+  if (!input.isValid()) {
+    printf("Cannot open input file %s\n", argv[1]);
+    return 1;
+  }
+  sk_sp<SkData> font_data = SkData::MakeFromStream(&input, input.getLength());
+  sk_sp<SkFontMgr> mgr = SkFontMgr_New_Custom_Empty();
+  sk_sp<SkTypeface> face = mgr->makeFromData(font_data);
+  if (!face) {
+    printf("input font %s was not parsable by Freetype\n", argv[1]);
+    return 1;
+  }
+  int count = argc > 2 ? atoi(argv[2]) : 5000;
+  if (count <= 0) {
+    printf("Invalid paragraph count %s\n", argv[2]);
+    return 1;
+  }
+
+  SkPaint paint;
+  paint.setAntiAlias(true);
+  paint.setColor(SK_ColorBLACK);
+  skia::textlayout::TextStyle style;
+  style.setForegroundColor(paint);
+  style.setFontFamilies({SkString("sans-serif")});
+  style.setFontSize(10.5);
+  skia::textlayout::ParagraphStyle paraStyle;
+  paraStyle.setTextStyle(style);
+
+  constexpr SkScalar width = 300;
+  std::vector<std::string> paragraphs = make_paragraphs(count);
+  sk_sp<SkFontMgr> one_mgr = sk_make_sp<OneFontMgr>(face);
+
+  std::vector<LaidOutParagraph> reference;
+  double baseMs = 0;
+  bool allSame = true;
+  int maxThreads =
+      static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+  printf("%d paragraphs at width %g\n", count, width);
+  printf("%7s %10s %12s %8s %s\n", "threads", "ms", "paragraphs/s", "speedup",
+         "check");
+  for (int threads = 1; threads <= maxThreads; threads *= 2) {
+    BulkParagraphLayout bulk(one_mgr, paraStyle, threads);
+    if (!bulk.valid()) {
+      printf("Cannot create the per-thread layout state (is ICU available?)\n");
+      return 1;
+    }
+    // The first call fills each worker's caches; time the second, as a long-lived
+    // service would see it.
+    bulk.layout(paragraphs, width);
+    auto t0 = Clock::now();
+    std::vector<LaidOutParagraph> results = bulk.layout(paragraphs, width);
+    double ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    const char* check = "reference";
+    if (threads == 1) {
+      reference = std::move(results);
+      baseMs = ms;
+      if (!same_layout(reference, reference)) {
+        check = "EMPTY";
+        allSame = false;
+      }
+    } else {
+      bool same = same_layout(reference, results);
+      allSame &= same;
+      check = same ? "identical" : "MISMATCH";
+    }
+    printf("%7d %10.1f %12.0f %7.2fx %s\n", threads, ms, count * 1000.0 / ms,
+           baseMs / ms, check);
+  }
+
+  if (argc == 4) {
+    SkFILEWStream output(argv[3]);
+    if (!output.isValid()) {
+      printf("Cannot open output file %s\n", argv[3]);
+      return 1;
+    }
+    sk_sp<SkSurface> surface = SkSurfaces::Raster(
+        SkImageInfo::MakeN32(width + 20, 800, kOpaque_SkAlphaType));
+    SkCanvas* canvas = surface->getCanvas();
+    canvas->clear(SK_ColorWHITE);
+    SkScalar y = 10;
+    for (const LaidOutParagraph& p : reference) {
+      if (y > 800) {
+        break;
+      }
+      canvas->drawTextBlob(p.blob, 10, y, paint);
+      y += p.height + 6;
+    }
+    SkPixmap pixmap;
+    if (!surface->peekPixels(&pixmap) ||
+        !SkJpegEncoder::Encode(&output, pixmap, {})) {
+      printf("Cannot write output\n");
+      return 1;
+    }
+  }
+  return allSame ? 0 : 1;
+}
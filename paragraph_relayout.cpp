@@ -0,0 +1,226 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+// Measures what shape_text.cpp would cost in a resizable UI, where the same paragraphs are
+// laid out again at many widths.
+//
+// skparagraph separates shaping (the expensive part, done once per text and style) from
+// line breaking at a width. There are two ways to avoid shaping again:
+//
+//  - keep the Paragraph alive: layout() at a new width only re-breaks the lines of the
+//    already shaped text;
+//  - the FontCollection's ParagraphCache: a newly built Paragraph with the same text and
+//    styles picks up the shaped runs of an earlier one.
+//
+// Each corpus paragraph is laid out at every width in three ways, and the time per layout
+// is reported for each: rebuilding with the cache off, rebuilding with the cache on, and
+// relayout of one kept-alive paragraph.
+
+#include "include/core/SkData.h"
+#include "include/core/SkFontMgr.h"
+#include "include/core/SkPaint.h"
+#include "include/core/SkRefCnt.h"
+#include "include/core/SkStream.h"
+#include "include/core/SkString.h"
+#include "include/core/SkTypeface.h"
+#include "include/ports/SkFontMgr_empty.h"
+#include "modules/skparagraph/include/FontCollection.h"
+#include "modules/skparagraph/include/Paragraph.h"
+#include "modules/skparagraph/include/ParagraphBuilder.h"
+#include "modules/skparagraph/include/ParagraphCache.h"
+#include "modules/skparagraph/include/ParagraphStyle.h"
+#include "modules/skunicode/include/SkUnicode_icu.h"
+
+#include "OneFontMgr.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using skia::textlayout::FontCollection;
+using skia::textlayout::Paragraph;
+using skia::textlayout::ParagraphBuilder;
+using skia::textlayout::ParagraphStyle;
+using skia::textlayout::TextStyle;
+
+// https://www.gutenberg.org/ebooks/72339
+constexpr const char* kDefaultCorpus[] = {
+    "The landing port at Titan had not changed much in five years.",
+    "The ship settled down on the scarred blast shield, beside the same trio "
+    "of squat square buildings, and quickly disgorged its scanty quota of "
+    "cargo and a lone passenger into the flexible tube that linked the loading "
+    "hatch with the main building.",
+    "As soon as the tube was disconnected, the ship screamed off through the "
+    "murky atmosphere, seemingly glad to get away from Titan and head back to "
+    "the more comfortable and settled parts of the Solar System.",
+};
+
+constexpr float kWidths[] = {120, 160, 200, 240, 320, 400, 480, 640, 800, 1024};
+
+// Splits text into paragraphs at blank lines.
+static std::vector<std::string> read_corpus(const char* path) {
+  std::vector<std::string> paragraphs;
+  sk_sp<SkData> data = SkData::MakeFromFileName(path);
+  if (!data) {
+    return paragraphs;
+  }
+  std::string text(static_cast<const char*>(data->data()), data->size());
+  std::string current;
+  size_t start = 0;
+  while (start <= text.size()) {
+    size_t end = text.find('\n', start);
+    std::string line = text.substr(start, end == std::string::npos ? end : end - start);
+    if (line.empty()) {
+      if (!current.empty()) {
+        paragraphs.push_back(current);
+        current.clear();
+      }
+    } else {
+      current += current.empty() ? line : " " + line;
+    }
+    if (end == std::string::npos) {
+      break;
+    }
+    start = end + 1;
+  }
+  if (!current.empty()) {
+    paragraphs.push_back(current);
+  }
+  return paragraphs;
+}
+
+class ParagraphFactory {
+ public:
+  ParagraphFactory(sk_sp<FontCollection> collection, sk_sp<SkUnicode> unicode)
+      : collection_(std::move(collection)), unicode_(std::move(unicode)) {
+    SkPaint paint;
+    paint.setAntiAlias(true);
+    TextStyle style;
+    style.setForegroundColor(paint);
+    style.setFontFamilies({SkString("sans-serif")});
+    style.setFontSize(10.5);
+    style_.setTextStyle(style);
+  }
+
+  std::unique_ptr<Paragraph> build(const std::string& text) const {
+    std::unique_ptr<ParagraphBuilder> builder =
+        ParagraphBuilder::make(style_, collection_, unicode_);
+    builder->addText(text.c_str(), text.size());
+    return builder->Build();
+  }
+
+ private:
+  sk_sp<FontCollection> collection_;
+  sk_sp<SkUnicode> unicode_;
+  ParagraphStyle style_;
+};
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3) {
+    printf("Usage: %s <font.ttf> [corpus.txt]\n", argv[0]);
+    return 1;
+  }
+
+  SkFILEStream input(argv[1]);
+  if (!input.isValid()) {
+    printf("Cannot open input file %s\n", argv[1]);
+    return 1;
+  }
+  sk_sp<SkData> font_data = SkData::MakeFromStream(&input, input.getLength());
+  sk_sp<SkFontMgr> mgr = SkFontMgr_New_Custom_Empty();
+  sk_sp<SkTypeface> face = mgr->makeFromData(font_data);
+  if (!face) {
+    printf("input font %s was not parsable by Freetype\n", argv[1]);
+    return 1;
+  }
+
+  std::vector<std::string> corpus;
+  if (argc == 3) {
+    corpus = read_corpus(argv[2]);
+    if (corpus.empty()) {
+      printf("No paragraphs in %s\n", argv[2]);
+      return 1;
+    }
+  } else {
+    corpus.assign(std::begin(kDefaultCorpus), std::end(kDefaultCorpus));
+  }
+
+  sk_sp<SkUnicode> unicode = SkUnicodes::ICU::Make();
+  if (!unicode) {
+    printf("Could not load unicode data\n");
+    return 1;
+  }
+  auto fontCollection = sk_make_sp<FontCollection>();
+  fontCollection->setDefaultFontManager(sk_make_sp<OneFontMgr>(face));
+  skia::textlayout::ParagraphCache* cache = fontCollection->getParagraphCache();
+  ParagraphFactory factory(fontCollection, unicode);
+
+  const int layouts = static_cast<int>(corpus.size() * std::size(kWidths));
+  auto time_ms = [](auto&& fn) {
+    auto t0 = Clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+  };
+
+  // A fresh Paragraph per width, shaped from scratch every time.
+  cache->reset();
+  cache->turnOn(false);
+  double uncachedMs = time_ms([&] {
+    for (const std::string& text : corpus) {
+      for (float width : kWidths) {
+        factory.build(text)->layout(width);
+      }
+    }
+  });
+
+  // A fresh Paragraph per width; only the first one per text is shaped.
+  cache->turnOn(true);
+  double cachedMs = time_ms([&] {
+    for (const std::string& text : corpus) {
+      for (float width : kWidths) {
+        factory.build(text)->layout(width);
+      }
+    }
+  });
+  int cacheEntries = cache->count();
+
+  // One Paragraph per text, kept alive: shaped on the first layout, re-broken afterwards.
+  // Timed separately so shaping and relayout can be compared directly.
+  cache->reset();
+  cache->turnOn(false);
+  std::vector<std::unique_ptr<Paragraph>> paragraphs;
+  double shapeMs = time_ms([&] {
+    for (const std::string& text : corpus) {
+      paragraphs.push_back(factory.build(text));
+      paragraphs.back()->layout(kWidths[0]);
+    }
+  });
+  double relayoutMs = time_ms([&] {
+    for (auto& paragraph : paragraphs) {
+      for (size_t i = 1; i < std::size(kWidths); ++i) {
+        paragraph->layout(kWidths[i]);
+      }
+    }
+  });
+  cache->turnOn(true);
+
+  const int relayouts = static_cast<int>(corpus.size() * (std::size(kWidths) - 1));
+  printf("%zu paragraphs x %zu widths\n", corpus.size(), std::size(kWidths));
+  printf("rebuild, cache off: %8.3f ms  %7.4f ms/layout\n", uncachedMs,
+         uncachedMs / layouts);
+  printf("rebuild, cache on:  %8.3f ms  %7.4f ms/layout  (%d cache entries)\n",
+         cachedMs, cachedMs / layouts, cacheEntries);
+  printf("shape + first layout: %6.3f ms  %7.4f ms/paragraph\n", shapeMs,
+         shapeMs / corpus.size());
+  printf("relayout kept alive:  %6.3f ms  %7.4f ms/layout\n", relayoutMs,
+         relayoutMs / relayouts);
+  return 0;
+}
@@ -0,0 +1,318 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+// write_to_pdf.cpp as a long-running service producing many small documents.
+//
+// Creating a font manager and matching "Roboto" for every document, and decoding the same
+// logo again each time, dominates the cost of small PDFs. PdfService does both once:
+//
+//  - typefaces are resolved when the service starts and stay resident, so their glyph
+//    caches and the SkPDF font metrics derived from them stay warm;
+//  - images are memoized by a hash of their encoded bytes. JPEGs are handed to SkPDF with
+//    their encoded data, which it embeds as-is (DCTDecode) instead of re-encoding; other
+//    images are decoded once and keep their pixels for every later document.
+//
+// The benchmark renders the same invoices both ways and reports documents per second.
+
+#include "include/codec/SkCodec.h"
+#include "include/codec/SkJpegDecoder.h"
+#include "include/codec/SkPngDecoder.h"
+#include "include/core/SkCanvas.h"
+#include "include/core/SkColor.h"
+#include "include/core/SkData.h"
+#include "include/core/SkDocument.h"
+#include "include/core/SkFont.h"
+#include "include/core/SkFontMgr.h"
+#include "include/core/SkFontStyle.h"
+#include "include/core/SkImage.h"
+#include "include/core/SkImageInfo.h"
+#include "include/core/SkPaint.h"
+#include "include/core/SkRect.h"
+#include "include/core/SkRefCnt.h"
+#include "include/core/SkSamplingOptions.h"
+#include "include/core/SkStream.h"
+#include "include/core/SkString.h"
+#include "include/core/SkSurface.h"
+#include "include/core/SkTypeface.h"
+#include "include/docs/SkPDFDocument.h"
+#include "include/encode/SkJpegEncoder.h"
+#include "include/encode/SkPngEncoder.h"
+
+#if defined(SK_FONTMGR_FONTCONFIG_AVAILABLE)
+#include "include/ports/SkFontMgr_fontconfig.h"
+#endif
+
+#if defined(SK_FONTMGR_CORETEXT_AVAILABLE)
+#include "include/ports/SkFontMgr_mac_ct.h"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static sk_sp<SkFontMgr> make_font_mgr() {
+#if defined(SK_FONTMGR_FONTCONFIG_AVAILABLE)
+    return SkFontMgr_New_FontConfig(nullptr);
+#elif defined(SK_FONTMGR_CORETEXT_AVAILABLE)
+    return SkFontMgr_New_CoreText(nullptr);
+#else
+    return nullptr;
+#endif
+}
+
+struct Invoice {
+    int                         fNumber;
+    std::vector<std::string>    fLines;
+    sk_sp<SkData>               fLogo;    // encoded image bytes, shared by many invoices
+};
+
+// Thread-safe memo of encoded bytes -> SkImage. The key only narrows the search; a hit
+// also requires the stored bytes to equal the caller's.
+class ImageStreamCache {
+public:
+    sk_sp<SkImage> find(const sk_sp<SkData>& encoded) {
+        Key key{std::hash<std::string_view>()(std::string_view(
+                        static_cast<const char*>(encoded->data()), encoded->size())),
+                encoded->size()};
+        std::lock_guard<std::mutex> lock(fMutex);
+        auto it = fImages.find(key);
+        if (it != fImages.end() && it->second.fEncoded->equals(encoded.get())) {
+            fHits++;
+            return it->second.fImage;
+        }
+        fMisses++;
+        sk_sp<SkImage> image = SkImages::DeferredFromEncodedData(encoded);
+        if (image && !is_jpeg(encoded)) {
+            // Decode now, and keep the pixels: a lazy image would be decoded again by
+            // every document that draws it.
+            image = image->makeRasterImage(nullptr);
+        }
+        // If the key collided with different bytes, keep the existing entry and don't cache.
+        if (it == fImages.end()) {
+            fImages[key] = {encoded, image};
+        }
+        return image;
+    }
+
+    int hits() const { std::lock_guard<std::mutex> lock(fMutex); return fHits; }
+    int misses() const { std::lock_guard<std::mutex> lock(fMutex); return fMisses; }
+
+private:
+    struct Key {
+        size_t fHash;
+        size_t fSize;
+        bool operator<(const Key& other) const {
+            return fHash != other.fHash ? fHash < other.fHash : fSize < other.fSize;
+        }
+    };
+
+    struct Entry {
+        sk_sp<SkData>  fEncoded;
+        sk_sp<SkImage> fImage;
+    };
+
+    static bool is_jpeg(const sk_sp<SkData>& data) {
+        return SkJpegDecoder::IsJpeg(data->data(), data->size());
+    }
+
+    mutable std::mutex                 fMutex;
+    std::map<Key, Entry>               fImages;
+    int                                fHits = 0;
+    int                                fMisses = 0;
+};
+
+class PdfService {
+public:
+    bool init() {
+        fFontMgr = make_font_mgr();
+        if (!fFontMgr) {
+            return false;
+        }
+        fRegular = fFontMgr->matchFamilyStyle("Roboto", SkFontStyle());
+        fBold = fFontMgr->matchFamilyStyle("Roboto", SkFontStyle::Bold());
+        if (!fBold) {
+            fBold = fRegular;
+        }
+        return fRegular != nullptr;
+    }
+
+    bool render(SkWStream* dst, const Invoice& invoice) {
+        return render_invoice(dst, invoice, fRegular, fBold, fImages.find(invoice.fLogo));
+    }
+
+    const ImageStreamCache& images() const { return fImages; }
+
+    // What write_to_pdf.cpp does: everything from scratch, every time.
+    static bool RenderCold(SkWStream* dst, const Invoice& invoice) {
+        sk_sp<SkFontMgr> mgr = make_font_mgr();
+        sk_sp<SkTypeface> regular = mgr ? mgr->matchFamilyStyle("Roboto", SkFontStyle())
+                                        : nullptr;
+        sk_sp<SkTypeface> bold = mgr ? mgr->matchFamilyStyle("Roboto", SkFontStyle::Bold())
+                                     : nullptr;
+        if (!regular) {
+            return false;
+        }
+        return render_invoice(dst, invoice, regular, bold ? bold : regular,
+                              SkImages::DeferredFromEncodedData(invoice.fLogo));
+    }
+
+private:
+    static bool render_invoice(SkWStream* dst, const Invoice& invoice,
+                               const sk_sp<SkTypeface>& regular, const sk_sp<SkTypeface>& bold,
+                               const sk_sp<SkImage>& logo) {
+        SkPDF::Metadata metadata;
+        metadata.fTitle = SkStringPrintf("Invoice %d", invoice.fNumber);
+        metadata.fAuthor = "Skia Demo Writer";
+        metadata.fLang = "eng";
+        metadata.fEncodingQuality = 90;
+        sk_sp<SkDocument> pdf = SkPDF::MakeDocument(dst, metadata);
+        if (!pdf) {
+            return false;
+        }
+        SkCanvas* canvas = pdf->beginPage(595, 842);  // A4
+
+        SkPaint paint;
+        paint.setColor(SK_ColorBLACK);
+        if (logo) {
+            canvas->drawImageRect(logo, SkRect::MakeXYWH(40, 40, 120, 60), SkSamplingOptions());
+        }
+        canvas->drawString(metadata.fTitle, 200, 80, SkFont(bold, 20), paint);
+        SkFont font(regular, 11);
+        SkScalar y = 140;
+        for (const std::string& line : invoice.fLines) {
+            canvas->drawString(line.c_str(), 40, y, font, paint);
+            y += 16;
+        }
+        pdf->endPage();
+        pdf->close();
+        return true;
+    }
+
+    sk_sp<SkFontMgr>    fFontMgr;
+    sk_sp<SkTypeface>   fRegular;
+    sk_sp<SkTypeface>   fBold;
+    ImageStreamCache    fImages;
+};
+
+static sk_sp<SkData> make_logo(bool jpeg) {
+    auto surface = SkSurfaces::Raster(SkImageInfo::MakeN32Premul(480, 240));
+    SkCanvas* canvas = surface->getCanvas();
+    canvas->clear(0xFF1A73E8);
+    SkPaint paint;
+    paint.setAntiAlias(true);
+    paint.setColor(SK_ColorWHITE);
+    canvas->drawCircle(120, 120, 90, paint);
+    paint.setColor(0xFFFBBC04);
+    canvas->drawRect(SkRect::MakeXYWH(240, 40, 200, 160), paint);
+    sk_sp<SkImage> image = surface->makeImageSnapshot();
+    if (jpeg) {
+        return SkJpegEncoder::Encode(nullptr, image.get(), {});
+    }
+    return SkPngEncoder::Encode(nullptr, image.get(), {});
+}
+
+// Runs render() for count documents on the given number of threads; returns documents/s.
+static double run(int count, int threads, const std::function<bool(const Invoice&)>& render,
+                  const std::vector<Invoice>& invoices, bool* ok) {
+    std::atomic<int> next{0};
+    std::atomic<bool> allOk{true};
+    auto start = Clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (int i = next++; i < count; i = next++) {
+                if (!render(invoices[i % invoices.size()])) {
+                    allOk = false;
+                }
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    *ok = allOk;
+    return count / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    int count = argc > 1 ? atoi(argv[1]) : 2000;
+    int threads = argc > 2 ? atoi(argv[2])
+                           : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    if (count <= 0 || threads <= 0) {
+        printf("Usage: %s [documents] [threads] [logo image ...]\n", argv[0]);
+        return 1;
+    }
+    SkCodecs::Register(SkJpegDecoder::Decoder());
+    SkCodecs::Register(SkPngDecoder::Decoder());
+
+    std::vector<sk_sp<SkData>> logos;
+    for (int i = 3; i < argc; ++i) {
+        sk_sp<SkData> data = SkData::MakeFromFileName(argv[i]);
+        if (!data) {
+            printf("Cannot read %s\n", argv[i]);
+            return 1;
+        }
+        logos.push_back(std::move(data));
+    }
+    if (logos.empty()) {
+        logos.push_back(make_logo(/*jpeg=*/true));
+        logos.push_back(make_logo(/*jpeg=*/false));
+    }
+
+    std::vector<Invoice> invoices;
+    for (int i = 0; i < 64; ++i) {
+        Invoice invoice{1000 + i, {}, logos[i % logos.size()]};
+        for (int line = 0; line < 20; ++line) {
+            invoice.fLines.push_back(SkStringPrintf("%3d  Widget type %c   x%2d   %8.2f EUR",
+                                                    line + 1, 'A' + (i + line) % 26,
+                                                    1 + line % 7, (i * 31 + line * 17) % 997 +
+                                                    0.99).c_str());
+        }
+        invoices.push_back(std::move(invoice));
+    }
+
+    PdfService service;
+    auto t0 = Clock::now();
+    if (!service.init()) {
+        printf("Cannot open typeface\n");
+        return 1;
+    }
+    double startupMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+    std::atomic<size_t> coldBytes{0}, serviceBytes{0};
+    bool coldOk = false, serviceOk = false;
+    double coldRate = run(count, threads, [&](const Invoice& invoice) {
+        SkDynamicMemoryWStream stream;
+        bool ok = PdfService::RenderCold(&stream, invoice);
+        coldBytes += stream.bytesWritten();
+        return ok;
+    }, invoices, &coldOk);
+    double serviceRate = run(count, threads, [&](const Invoice& invoice) {
+        SkDynamicMemoryWStream stream;
+        bool ok = service.render(&stream, invoice);
+        serviceBytes += stream.bytesWritten();
+        return ok;
+    }, invoices, &serviceOk);
+
+    printf("%d documents on %d threads\n", count, threads);
+    printf("cold:    %8.1f docs/s  %8zu bytes/doc\n", coldRate, coldBytes.load() / count);
+    printf("service: %8.1f docs/s  %8zu bytes/doc  (startup %.1f ms, images %d hits %d misses)\n",
+           serviceRate, serviceBytes.load() / count, startupMs, service.images().hits(),
+           service.images().misses());
+    printf("speedup: %.2fx\n", serviceRate / coldRate);
+    return coldOk && serviceOk ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+// Compares SkPngEncoder with the strip-parallel encoder in ParallelPngEncoder.cpp on a
+// large rendered surface, for increasing thread counts, and checks that every parallel
+// encode decodes back to the original pixels with SkPngDecoder.
+
+#include "include/codec/SkCodec.h"
+#include "include/codec/SkPngDecoder.h"
+#include "include/core/SkAlphaType.h"
+#include "include/core/SkBitmap.h"
+#include "include/core/SkCanvas.h"
+#include "include/core/SkColor.h"
+#include "include/core/SkData.h"
+#include "include/core/SkImageInfo.h"
+#include "include/core/SkPaint.h"
+#include "include/core/SkPixmap.h"
+#include "include/core/SkRefCnt.h"
+#include "include/core/SkStream.h"
+#include "include/core/SkString.h"
+#include "include/core/SkSurface.h"
+#include "include/effects/SkGradientShader.h"
+#include "include/encode/SkPngEncoder.h"
+
+#include "ParallelPngEncoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+// Something between a chart and a map: gradients, lots of antialiased strokes and flat fills.
+static void draw_content(SkCanvas* canvas, int width, int height) {
+    const SkPoint pts[] = {{0, 0}, {SkIntToScalar(width), SkIntToScalar(height)}};
+    const SkColor colors[] = {0xFFF0F4FF, 0xFFFFF4E0, 0xFFE8FFE8};
+    SkPaint background;
+    background.setShader(SkGradientShader::MakeLinear(pts, colors, nullptr, 3,
+                                                      SkTileMode::kClamp));
+    canvas->drawPaint(background);
+
+    SkPaint stroke;
+    stroke.setAntiAlias(true);
+    stroke.setStyle(SkPaint::kStroke_Style);
+    SkPaint fill;
+    fill.setAntiAlias(true);
+    uint32_t seed = 1;
+    auto next = [&seed] { seed = seed * 1664525 + 1013904223; return seed >> 8; };
+    for (int i = 0; i < 20000; ++i) {
+        float x = next() % width, y = next() % height;
+        stroke.setColor(0xFF000000 | next());
+        stroke.setStrokeWidth(1 + next() % 4);
+        canvas->drawLine(x, y, x + (int)(next() % 200) - 100, y + (int)(next() % 200) - 100,
+                         stroke);
+        if (i % 8 == 0) {
+            fill.setColor(0x80000000 | next());
+            canvas->drawCircle(x, y, 4 + next() % 40, fill);
+        }
+    }
+}
+
+static bool decodes_to(const sk_sp<SkData>& png, const SkPixmap& expected) {
+    std::unique_ptr<SkCodec> codec = SkPngDecoder::Decode(png, nullptr);
+    if (!codec || codec->dimensions() != expected.dimensions()) {
+        return false;
+    }
+    SkBitmap decoded;
+    decoded.allocPixels(expected.info());
+    if (codec->getPixels(decoded.pixmap()) != SkCodec::kSuccess) {
+        return false;
+    }
+    for (int y = 0; y < expected.height(); ++y) {
+        if (memcmp(decoded.getAddr(0, y), expected.addr(0, y), expected.info().minRowBytes())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int width = argc > 1 ? atoi(argv[1]) : 8192;
+    int height = argc > 2 ? atoi(argv[2]) : 4608;
+    int maxThreads = argc > 3 ? atoi(argv[3])
+                              : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    if (width <= 0 || height <= 0 || maxThreads <= 0) {
+        printf("Usage: %s [width] [height] [max threads]\n", argv[0]);
+        return 1;
+    }
+
+    sk_sp<SkSurface> surface =
+            SkSurfaces::Raster(SkImageInfo::MakeN32(width, height, kOpaque_SkAlphaType));
+    if (!surface) {
+        printf("Cannot allocate a %dx%d surface\n", width, height);
+        return 1;
+    }
+    auto t0 = Clock::now();
+    draw_content(surface->getCanvas(), width, height);
+    double renderMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+    SkPixmap pixmap;
+    if (!surface->peekPixels(&pixmap)) {
+        printf("Cannot readback on surface\n");
+        return 1;
+    }
+    printf("%dx%d, render %.1f ms\n", width, height, renderMs);
+    printf("%-22s %8s %10s %8s %s\n", "encoder", "ms", "bytes", "speedup", "round-trip");
+
+    SkDynamicMemoryWStream reference;
+    t0 = Clock::now();
+    if (!SkPngEncoder::Encode(&reference, pixmap, {})) {
+        printf("SkPngEncoder failed\n");
+        return 1;
+    }
+    double baseMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    printf("%-22s %8.1f %10zu %7.2fx %s\n", "SkPngEncoder", baseMs, reference.bytesWritten(),
+           1.0, "-");
+
+    bool allOk = true;
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        ParallelPngOptions options;
+        options.fThreads = threads;
+        SkDynamicMemoryWStream stream;
+        t0 = Clock::now();
+        bool encoded = ParallelPngEncode(&stream, pixmap, options);
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        size_t bytes = stream.bytesWritten();
+        bool ok = encoded && decodes_to(stream.detachAsData(), pixmap);
+        allOk &= ok;
+        SkString label = SkStringPrintf("parallel x%d", threads);
+        printf("%-22s %8.1f %10zu %7.2fx %s\n", label.c_str(), ms, bytes, baseMs / ms,
+               ok ? "ok" : "MISMATCH");
+    }
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+// A batch version of svg_renderer.cpp, for rasterizing icons at many sizes and scales.
+//
+// The font manager and shaper factory are created once for the whole run. Each SVG is then
+// parsed once and rendered once into an SkPicture; every output size is a replay of that
+// picture into a raster surface, and surfaces are reused between icons of the same output
+// dimensions. Parse, record, replay and PNG encode times are reported separately.
+
+#include "include/core/SkCanvas.h"
+#include "include/core/SkColor.h"
+#include "include/core/SkFontMgr.h"
+#include "include/core/SkImageInfo.h"
+#include "include/core/SkPicture.h"
+#include "include/core/SkPictureRecorder.h"
+#include "include/core/SkPixmap.h"
+#include "include/core/SkRect.h"
+#include "include/core/SkRefCnt.h"
+#include "include/core/SkSize.h"
+#include "include/core/SkStream.h"
+#include "include/core/SkSurface.h"
+#include "include/encode/SkPngEncoder.h"
+#include "modules/skshaper/include/SkShaper_factory.h"
+#include "modules/skshaper/utils/FactoryHelpers.h"
+#include "modules/svg/include/SkSVGDOM.h"
+#include "modules/svg/include/SkSVGSVG.h"
+
+#if defined(SK_FONTMGR_FONTCONFIG_AVAILABLE)
+#include "include/ports/SkFontMgr_fontconfig.h"
+#endif
+
+#if defined(SK_FONTMGR_CORETEXT_AVAILABLE)
+#include "include/ports/SkFontMgr_mac_ct.h"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Parses a comma separated list of positive numbers, e.g. "16,24,32".
+static std::vector<float> parse_list(const char* arg) {
+    std::vector<float> values;
+    for (const char* p = arg; *p;) {
+        char* end;
+        float v = strtof(p, &end);
+        if (end == p || v <= 0) {
+            return {};
+        }
+        values.push_back(v);
+        p = *end == ',' ? end + 1 : end;
+    }
+    return values;
+}
+
+// Raster surfaces keyed by dimensions, so that rendering many icons at the same sizes
+// allocates each size once.
+class SurfacePool {
+public:
+    SkSurface* get(int width, int height) {
+        sk_sp<SkSurface>& surface = fSurfaces[{width, height}];
+        if (!surface) {
+            surface = SkSurfaces::Raster(SkImageInfo::MakeN32Premul(width, height));
+        }
+        return surface.get();
+    }
+
+    size_t size() const { return fSurfaces.size(); }
+
+private:
+    std::map<std::pair<int, int>, sk_sp<SkSurface>> fSurfaces;
+};
+
+struct Timings {
+    double fParse = 0;
+    double fRecord = 0;
+    double fReplay = 0;
+    double fEncode = 0;
+};
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        printf("Usage: %s <output dir> <sizes, e.g. 16,24,32,48,64> [--scales 1,2,3] "
+               "<file.svg> ...\n", argv[0]);
+        return 1;
+    }
+    std::filesystem::path outputDir = argv[1];
+    std::vector<float> sizes = parse_list(argv[2]);
+    std::vector<float> scales = {1};
+    int firstInput = 3;
+    if (!strcmp(argv[3], "--scales") && argc > 4) {
+        scales = parse_list(argv[4]);
+        firstInput = 5;
+    }
+    if (sizes.empty() || scales.empty() || firstInput >= argc) {
+        printf("Invalid sizes or scales, or no input files\n");
+        return 1;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(outputDir, ec);
+
+    // Process-wide setup, shared by every document.
+    auto t0 = Clock::now();
+    sk_sp<SkFontMgr> fontMgr;
+#if defined(SK_FONTMGR_FONTCONFIG_AVAILABLE)
+    fontMgr = SkFontMgr_New_FontConfig(nullptr);
+#elif defined(SK_FONTMGR_CORETEXT_AVAILABLE)
+    fontMgr = SkFontMgr_New_CoreText(nullptr);
+#endif
+    if (!fontMgr) {
+        printf("No Font Manager configured\n");
+        return 1;
+    }
+    sk_sp<SkShapers::Factory> shaperFactory = SkShapers::BestAvailable();
+    double setupMs = ms_since(t0);
+
+    SurfacePool surfaces;
+    Timings total;
+    int files = 0, outputs = 0;
+    for (int i = firstInput; i < argc; ++i) {
+        SkFILEStream stream(argv[i]);
+        if (!stream.isValid()) {
+            printf("Cannot open %s\n", argv[i]);
+            continue;
+        }
+
+        t0 = Clock::now();
+        auto dom = SkSVGDOM::Builder()
+                           .setFontManager(fontMgr)
+                           .setTextShapingFactory(shaperFactory)
+                           .make(stream);
+        total.fParse += ms_since(t0);
+        if (!dom) {
+            printf("Could not parse %s\n", argv[i]);
+            continue;
+        }
+
+        // Icons often only have a viewBox, in which case the intrinsic size is empty.
+        SkSize size = dom->containerSize();
+        if (size.isEmpty()) {
+            const auto& viewBox = dom->getRoot()->getViewBox();
+            size = viewBox ? viewBox->size() : SkSize::Make(100, 100);
+        }
+
+        t0 = Clock::now();
+        SkPictureRecorder recorder;
+        dom->setContainerSize(size);
+        dom->render(recorder.beginRecording(SkRect::MakeSize(size)));
+        sk_sp<SkPicture> picture = recorder.finishRecordingAsPicture();
+        total.fRecord += ms_since(t0);
+
+        std::string stem = std::filesystem::path(argv[i]).stem().string();
+        for (float scale : scales) {
+            for (float target : sizes) {
+                // target is the longer edge in CSS pixels, before the device scale.
+                float factor = target * scale / std::max(size.width(), size.height());
+                int width = std::max(1, (int)std::lround(size.width() * factor));
+                int height = std::max(1, (int)std::lround(size.height() * factor));
+
+                t0 = Clock::now();
+                SkSurface* surface = surfaces.get(width, height);
+                SkCanvas* canvas = surface->getCanvas();
+                canvas->clear(SK_ColorTRANSPARENT);
+                canvas->save();
+                canvas->scale(factor, factor);
+                canvas->drawPicture(picture);
+                canvas->restore();
+                total.fReplay += ms_since(t0);
+
+                SkPixmap pixmap;
+                surface->peekPixels(&pixmap);
+                char name[64];
+                snprintf(name, sizeof(name), "_%g@%gx.png", target, scale);
+                SkFILEWStream output((outputDir / (stem + name)).c_str());
+                t0 = Clock::now();
+                if (!output.isValid() || !SkPngEncoder::Encode(&output, pixmap, {})) {
+                    printf("Cannot write %s%s\n", stem.c_str(), name);
+                    continue;
+                }
+                total.fEncode += ms_since(t0);
+                outputs++;
+            }
+        }
+        files++;
+    }
+
+    printf("%d files, %d images, %zu distinct surfaces\n", files, outputs, surfaces.size());
+    printf("setup  %9.2f ms (once)\n", setupMs);
+    printf("parse  %9.2f ms (%.3f ms/file)\n", total.fParse, total.fParse / std::max(files, 1));
+    printf("record %9.2f ms (%.3f ms/file)\n", total.fRecord,
+           total.fRecord / std::max(files, 1));
+    printf("replay %9.2f ms (%.3f ms/image)\n", total.fReplay,
+           total.fReplay / std::max(outputs, 1));
+    printf("encode %9.2f ms (%.3f ms/image)\n", total.fEncode,
+           total.fEncode / std::max(outputs, 1));
+    return files > 0 ? 0 : 1;
+}
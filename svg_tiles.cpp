@@ -0,0 +1,287 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+// Renders a (large) SVG in tiles on a thread pool, instead of into one giant surface as
+// svg_renderer.cpp does.
+//
+// The DOM is recorded once into an SkPicture with an R-tree, so each tile only replays the
+// draws that touch it. Each tile gets its own raster canvas, translated to the tile origin
+// and clipped to the tile.
+//
+// The output is either one PNG, written a band of tiles at a time through PngStripWriter
+// while the next band renders, or (if the output names a directory) one PNG per tile. Either
+// way only a couple of bands of tiles are in memory at any time, whatever the image size.
+
+#include "include/core/SkBBHFactory.h"
+#include "include/core/SkBitmap.h"
+#include "include/core/SkCanvas.h"
+#include "include/core/SkColor.h"
+#include "include/core/SkExecutor.h"
+#include "include/core/SkFontMgr.h"
+#include "include/core/SkImageInfo.h"
+#include "include/core/SkPicture.h"
+#include "include/core/SkPictureRecorder.h"
+#include "include/core/SkPixmap.h"
+#include "include/core/SkRect.h"
+#include "include/core/SkRefCnt.h"
+#include "include/core/SkSize.h"
+#include "include/core/SkStream.h"
+#include "include/core/SkSurface.h"
+#include "include/encode/SkPngEncoder.h"
+#include "modules/skshaper/utils/FactoryHelpers.h"
+#include "modules/svg/include/SkSVGDOM.h"
+#include "modules/svg/include/SkSVGSVG.h"
+
+#if defined(SK_FONTMGR_FONTCONFIG_AVAILABLE)
+#include "include/ports/SkFontMgr_fontconfig.h"
+#endif
+
+#if defined(SK_FONTMGR_CORETEXT_AVAILABLE)
+#include "include/ports/SkFontMgr_mac_ct.h"
+#endif
+
+#include "ParallelPngEncoder.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+static double ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Counts outstanding tile tasks; wait() returns once all of them have called done().
+class Latch {
+public:
+    void reset(int count) { fCount = count; }
+
+    void done() {
+        std::lock_guard<std::mutex> lock(fMutex);
+        if (--fCount == 0) {
+            fZero.notify_all();
+        }
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(fMutex);
+        fZero.wait(lock, [this] { return fCount == 0; });
+    }
+
+private:
+    std::mutex              fMutex;
+    std::condition_variable fZero;
+    int                     fCount = 0;
+};
+
+// One row of tiles, as tall as a tile and as wide as the image.
+struct Band {
+    SkBitmap fPixels;
+    int      fTop = 0;
+    Latch    fLatch;
+};
+
+static void draw_tile(SkCanvas* canvas, const SkIRect& tile, float scale,
+                      const sk_sp<SkPicture>& picture) {
+    canvas->clear(SK_ColorTRANSPARENT);
+    canvas->translate(-tile.left(), -tile.top());
+    canvas->clipRect(SkRect::Make(tile));
+    canvas->scale(scale, scale);
+    canvas->drawPicture(picture);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printf("Usage: %s <file.svg> <output.png | output dir/> [--width PX] [--tile PX] "
+               "[--threads N]\n", argv[0]);
+        return 1;
+    }
+    const char* input = argv[1];
+    std::filesystem::path output = argv[2];
+    int width = 0;
+    int tileSize = 512;
+    int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int i = 3; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--width")) {
+            width = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--tile")) {
+            tileSize = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--threads")) {
+            threads = atoi(argv[i + 1]);
+        } else {
+            printf("Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (tileSize <= 0 || threads <= 0 || width < 0) {
+        printf("Invalid --width, --tile or --threads\n");
+        return 1;
+    }
+    bool tilesToDir = std::filesystem::is_directory(output) ||
+                      argv[2][strlen(argv[2]) - 1] == '/';
+
+    sk_sp<SkFontMgr> fontMgr;
+#if defined(SK_FONTMGR_FONTCONFIG_AVAILABLE)
+    fontMgr = SkFontMgr_New_FontConfig(nullptr);
+#elif defined(SK_FONTMGR_CORETEXT_AVAILABLE)
+    fontMgr = SkFontMgr_New_CoreText(nullptr);
+#endif
+    if (!fontMgr) {
+        printf("No Font Manager configured\n");
+        return 1;
+    }
+
+    SkFILEStream stream(input);
+    if (!stream.isValid()) {
+        printf("Cannot open %s\n", input);
+        return 1;
+    }
+    auto t0 = Clock::now();
+    auto dom = SkSVGDOM::Builder()
+                       .setFontManager(fontMgr)
+                       .setTextShapingFactory(SkShapers::BestAvailable())
+                       .make(stream);
+    if (!dom) {
+        printf("Could not parse %s\n", input);
+        return 1;
+    }
+    double parseMs = ms_since(t0);
+
+    SkSize size = dom->containerSize();
+    if (size.isEmpty()) {
+        const auto& viewBox = dom->getRoot()->getViewBox();
+        size = viewBox ? viewBox->size() : SkSize::Make(100, 100);
+    }
+
+    t0 = Clock::now();
+    SkRTreeFactory bbhFactory;
+    SkPictureRecorder recorder;
+    dom->setContainerSize(size);
+    dom->render(recorder.beginRecording(SkRect::MakeSize(size), &bbhFactory));
+    sk_sp<SkPicture> picture = recorder.finishRecordingAsPicture();
+    double recordMs = ms_since(t0);
+    dom.reset();
+
+    const float scale = width > 0 ? width / size.width() : 1.0f;
+    const int outWidth = std::max(1, (int)std::lround(size.width() * scale));
+    const int outHeight = std::max(1, (int)std::lround(size.height() * scale));
+    const int columns = (outWidth + tileSize - 1) / tileSize;
+    const int rows = (outHeight + tileSize - 1) / tileSize;
+
+    std::unique_ptr<SkExecutor> pool = SkExecutor::MakeFIFOThreadPool(threads);
+    std::atomic<bool> ok{true};
+    t0 = Clock::now();
+
+    if (tilesToDir) {
+        std::error_code ec;
+        std::filesystem::create_directories(output, ec);
+        // Every tile is queued up front, but a tile only has pixels while a thread is
+        // rendering and writing it.
+        Latch latch;
+        latch.reset(rows * columns);
+        for (int r = 0; r < rows; ++r) {
+            for (int c = 0; c < columns; ++c) {
+                pool->add([&, r, c] {
+                    SkIRect tile = SkIRect::MakeLTRB(c * tileSize, r * tileSize,
+                                                     std::min(outWidth, (c + 1) * tileSize),
+                                                     std::min(outHeight, (r + 1) * tileSize));
+                    auto surface = SkSurfaces::Raster(
+                            SkImageInfo::MakeN32Premul(tile.width(), tile.height()));
+                    draw_tile(surface->getCanvas(), tile, scale, picture);
+                    SkPixmap pixmap;
+                    surface->peekPixels(&pixmap);
+                    char name[64];
+                    snprintf(name, sizeof(name), "tile_%03d_%03d.png", r, c);
+                    SkFILEWStream file((output / name).c_str());
+                    if (!file.isValid() || !SkPngEncoder::Encode(&file, pixmap, {})) {
+                        ok = false;
+                    }
+                    latch.done();
+                });
+            }
+        }
+        latch.wait();
+    } else {
+        SkFILEWStream file(output.c_str());
+        if (!file.isValid()) {
+            printf("Cannot open output file %s\n", output.c_str());
+            return 1;
+        }
+        PngStripWriter writer(&file, outWidth, outHeight, /*opaque=*/false);
+
+        // Two bands: one being rendered by the pool while the other is being compressed.
+        Band bands[2];
+        auto startBand = [&](int r) {
+            Band& band = bands[r % 2];
+            band.fTop = r * tileSize;
+            int height = std::min(tileSize, outHeight - band.fTop);
+            if (band.fPixels.height() != height) {
+                band.fPixels.allocPixels(SkImageInfo::MakeN32Premul(outWidth, height));
+            }
+            band.fLatch.reset(columns);
+            for (int c = 0; c < columns; ++c) {
+                pool->add([&band, &picture, c, height, tileSize, outWidth, scale] {
+                    SkIRect tile = SkIRect::MakeXYWH(c * tileSize, band.fTop,
+                                                     std::min(tileSize, outWidth - c * tileSize),
+                                                     height);
+                    SkPixmap pixmap;
+                    band.fPixels.pixmap().extractSubset(
+                            &pixmap, SkIRect::MakeXYWH(tile.left(), 0, tile.width(), height));
+                    std::unique_ptr<SkCanvas> canvas = SkCanvas::MakeRasterDirect(
+                            pixmap.info(), pixmap.writable_addr(), pixmap.rowBytes());
+                    draw_tile(canvas.get(), tile, scale, picture);
+                    band.fLatch.done();
+                });
+            }
+        };
+
+        startBand(0);
+        for (int r = 0; r < rows; ++r) {
+            bands[r % 2].fLatch.wait();
+            if (r + 1 < rows) {
+                startBand(r + 1);
+            }
+            if (!writer.writeRows(bands[r % 2].fPixels.pixmap())) {
+                ok = false;
+                // Let the band in flight finish before it goes out of scope.
+                if (r + 1 < rows) {
+                    bands[(r + 1) % 2].fLatch.wait();
+                }
+                break;
+            }
+        }
+        if (ok && !writer.finish()) {
+            ok = false;
+        }
+    }
+    double renderMs = ms_since(t0);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("%dx%d in %dx%d tiles of %d px on %d threads\n", outWidth, outHeight, columns, rows,
+           tileSize, threads);
+    printf("parse %.1f ms, record %.1f ms, render+write %.1f ms, peak rss %ld KB\n", parseMs,
+           recordMs, renderMs, usage.ru_maxrss);
+    if (!ok) {
+        printf("Writing the output failed\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,387 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+// write_text_to_png.cpp for many badges at once.
+//
+// Jobs are read one per line from a JSONL file, or stdin, e.g.
+//
+//   {"text": "Hello world!", "font": "Roboto", "size": 14, "fg": "#00ff00",
+//    "bg": "#ffff00", "out": "hello.png"}
+//
+// Only "text" and "out" are required. The font manager is created once, typefaces and SkFonts
+// are shared by all badges with the same font and size, and badges are drawn into pooled
+// raster surfaces by size class. Rendering happens on the main thread; PNG encoding and
+// writing happen on worker threads, which hand each surface back to the pool when done.
+//
+// Reports badges per second and heap allocations (operator new) per badge.
+
+#include "include/core/SkCanvas.h"
+#include "include/core/SkColor.h"
+#include "include/core/SkFont.h"
+#include "include/core/SkFontMetrics.h"
+#include "include/core/SkFontMgr.h"
+#include "include/core/SkFontStyle.h"
+#include "include/core/SkFontTypes.h"
+#include "include/core/SkImageInfo.h"
+#include "include/core/SkPaint.h"
+#include "include/core/SkPixmap.h"
+#include "include/core/SkRect.h"
+#include "include/core/SkRefCnt.h"
+#include "include/core/SkStream.h"
+#include "include/core/SkSurface.h"
+#include "include/core/SkTypeface.h"
+#include "include/encode/SkPngEncoder.h"
+
+#if defined(SK_FONTMGR_FONTCONFIG_AVAILABLE)
+#include "include/ports/SkFontMgr_fontconfig.h"
+#endif
+
+#if defined(SK_FONTMGR_CORETEXT_AVAILABLE)
+#include "include/ports/SkFontMgr_mac_ct.h"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// Counts every operator new in the process, including those made inside Skia.
+static std::atomic<size_t> gAllocations{0};
+
+void* operator new(size_t size) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+constexpr SkScalar kPadding = 6;
+
+struct Job {
+    std::string fText;
+    std::string fFont = "Roboto";
+    float       fSize = 14;
+    SkColor     fForeground = SK_ColorBLACK;
+    SkColor     fBackground = SK_ColorWHITE;
+    std::string fOut;
+};
+
+// Reads a JSON string starting at the opening quote; handles the common escapes.
+static bool read_string(const std::string& line, size_t* pos, std::string* out) {
+    out->clear();
+    for (size_t i = *pos + 1; i < line.size(); ++i) {
+        char c = line[i];
+        if (c == '"') {
+            *pos = i + 1;
+            return true;
+        }
+        if (c == '\\' && i + 1 < line.size()) {
+            c = line[++i];
+            switch (c) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                default: break;  // \" \\ \/ stay as the escaped character
+            }
+        }
+        out->push_back(c);
+    }
+    return false;
+}
+
+static SkColor parse_color(const std::string& s, SkColor fallback) {
+    if (s.size() == 7 && s[0] == '#') {
+        return 0xFF000000 | static_cast<SkColor>(strtoul(s.c_str() + 1, nullptr, 16));
+    }
+    if (s.size() == 9 && s[0] == '#') {  // #aarrggbb
+        return static_cast<SkColor>(strtoul(s.c_str() + 1, nullptr, 16));
+    }
+    return fallback;
+}
+
+// Parses one flat JSON object of string and number values.
+static bool parse_job(const std::string& line, Job* job) {
+    size_t pos = line.find('{');
+    if (pos == std::string::npos) {
+        return false;
+    }
+    ++pos;
+    while (pos < line.size()) {
+        pos = line.find_first_of("\"}", pos);
+        if (pos == std::string::npos || line[pos] == '}') {
+            break;
+        }
+        std::string key, value;
+        if (!read_string(line, &pos, &key)) {
+            return false;
+        }
+        pos = line.find(':', pos);
+        if (pos == std::string::npos) {
+            return false;
+        }
+        pos = line.find_first_not_of(" \t", pos + 1);
+        if (pos == std::string::npos) {
+            return false;
+        }
+        if (line[pos] == '"') {
+            if (!read_string(line, &pos, &value)) {
+                return false;
+            }
+        } else {
+            size_t end = line.find_first_of(",}", pos);
+            value = line.substr(pos, end - pos);
+            pos = end;
+        }
+        if (key == "text") {
+            job->fText = value;
+        } else if (key == "font") {
+            job->fFont = value;
+        } else if (key == "size") {
+            job->fSize = strtof(value.c_str(), nullptr);
+        } else if (key == "fg") {
+            job->fForeground = parse_color(value, job->fForeground);
+        } else if (key == "bg") {
+            job->fBackground = parse_color(value, job->fBackground);
+        } else if (key == "out") {
+            job->fOut = value;
+        }
+    }
+    return !job->fText.empty() && !job->fOut.empty() && job->fSize > 0;
+}
+
+// Typefaces by family and SkFonts by family and size, created on first use.
+class FontCache {
+public:
+    explicit FontCache(sk_sp<SkFontMgr> mgr) : fMgr(std::move(mgr)) {}
+
+    const SkFont* font(const std::string& family, float size) {
+        auto key = std::make_pair(family, size);
+        auto it = fFonts.find(key);
+        if (it != fFonts.end()) {
+            return &it->second;
+        }
+        sk_sp<SkTypeface>& face = fTypefaces[family];
+        if (!face) {
+            face = fMgr->matchFamilyStyle(family.c_str(), SkFontStyle());
+            if (!face) {
+                face = fMgr->legacyMakeTypeface(nullptr, SkFontStyle());
+            }
+            if (!face) {
+                return nullptr;
+            }
+        }
+        SkFont font(face, size);
+        font.setEdging(SkFont::Edging::kAntiAlias);
+        return &fFonts.emplace(key, font).first->second;
+    }
+
+    size_t typefaces() const { return fTypefaces.size(); }
+
+private:
+    sk_sp<SkFontMgr>                                fMgr;
+    std::map<std::string, sk_sp<SkTypeface>>        fTypefaces;
+    std::map<std::pair<std::string, float>, SkFont> fFonts;
+};
+
+// Raster surfaces bucketed by size class: width rounded up to 64 and height to 16 pixels.
+// A badge draws into the top-left corner of a surface of its class and is encoded from
+// that subset. Surfaces are taken out while a badge is drawn and encoded, and returned
+// afterwards; acquire() blocks once the limit of surfaces in use is reached.
+class SurfacePool {
+public:
+    explicit SurfacePool(int maxInUse) : fMaxInUse(maxInUse) {}
+
+    sk_sp<SkSurface> acquire(int width, int height) {
+        std::pair<int, int> sizeClass = {(width + 63) & ~63, (height + 15) & ~15};
+        std::unique_lock<std::mutex> lock(fMutex);
+        fReturned.wait(lock, [this] { return fInUse < fMaxInUse; });
+        fInUse++;
+        std::vector<sk_sp<SkSurface>>& free = fFree[sizeClass];
+        if (!free.empty()) {
+            sk_sp<SkSurface> surface = std::move(free.back());
+            free.pop_back();
+            return surface;
+        }
+        fCreated++;
+        lock.unlock();
+        return SkSurfaces::Raster(SkImageInfo::MakeN32Premul(sizeClass.first,
+                                                             sizeClass.second));
+    }
+
+    void release(sk_sp<SkSurface> surface) {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fFree[{surface->width(), surface->height()}].push_back(std::move(surface));
+        fInUse--;
+        fReturned.notify_one();
+    }
+
+    int created() const {
+        std::lock_guard<std::mutex> lock(fMutex);
+        return fCreated;
+    }
+
+private:
+    mutable std::mutex                                           fMutex;
+    std::condition_variable                                      fReturned;
+    std::map<std::pair<int, int>, std::vector<sk_sp<SkSurface>>> fFree;
+    const int                                                    fMaxInUse;
+    int                                                          fInUse = 0;
+    int                                                          fCreated = 0;
+};
+
+struct EncodeTask {
+    sk_sp<SkSurface> fSurface;
+    SkIRect          fBounds;
+    std::string      fOut;
+};
+
+int main(int argc, char** argv) {
+    if (argc > 3) {
+        printf("Usage: %s [jobs.jsonl | -] [encode threads]\n", argv[0]);
+        return 1;
+    }
+    std::ifstream file;
+    if (argc > 1 && strcmp(argv[1], "-")) {
+        file.open(argv[1]);
+        if (!file) {
+            printf("Cannot open %s\n", argv[1]);
+            return 1;
+        }
+    }
+    std::istream& input = file.is_open() ? file : std::cin;
+    int threads = argc > 2 ? atoi(argv[2])
+                           : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    if (threads <= 0) {
+        printf("Invalid thread count %s\n", argv[2]);
+        return 1;
+    }
+
+#if defined(SK_FONTMGR_FONTCONFIG_AVAILABLE)
+    sk_sp<SkFontMgr> mgr = SkFontMgr_New_FontConfig(nullptr);
+#elif defined(SK_FONTMGR_CORETEXT_AVAILABLE)
+    sk_sp<SkFontMgr> mgr = SkFontMgr_New_CoreText(nullptr);
+#else
+    sk_sp<SkFontMgr> mgr;
+#endif
+    if (!mgr) {
+        printf("No Font Manager configured\n");
+        return 1;
+    }
+    FontCache fonts(mgr);
+    SurfacePool pool(threads * 4);
+
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::deque<EncodeTask> queue;
+    bool done = false;
+    std::atomic<int> written{0}, failed{0};
+
+    std::vector<std::thread> encoders;
+    for (int t = 0; t < threads; ++t) {
+        encoders.emplace_back([&] {
+            for (;;) {
+                EncodeTask task;
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    queueReady.wait(lock, [&] { return !queue.empty() || done; });
+                    if (queue.empty()) {
+                        return;
+                    }
+                    task = std::move(queue.front());
+                    queue.pop_front();
+                }
+                SkPixmap all, badge;
+                SkFILEWStream output(task.fOut.c_str());
+                bool ok = output.isValid() && task.fSurface->peekPixels(&all) &&
+                          all.extractSubset(&badge, task.fBounds) &&
+                          SkPngEncoder::Encode(&output, badge, {});
+                (ok ? written : failed)++;
+                pool.release(std::move(task.fSurface));
+            }
+        });
+    }
+
+    SkPaint background, text;
+    text.setAntiAlias(true);
+    int badges = 0, invalid = 0;
+    size_t allocationsBefore = gAllocations.load();
+    auto start = Clock::now();
+    std::string line;
+    Job job;
+    while (std::getline(input, line)) {
+        job = Job();
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        const SkFont* font = parse_job(line, &job) ? fonts.font(job.fFont, job.fSize) : nullptr;
+        if (!font) {
+            invalid++;
+            continue;
+        }
+        SkFontMetrics metrics;
+        font->getMetrics(&metrics);
+        SkScalar textWidth = font->measureText(job.fText.c_str(), job.fText.size(),
+                                               SkTextEncoding::kUTF8);
+        int width = static_cast<int>(std::ceil(textWidth + 2 * kPadding));
+        int height = static_cast<int>(std::ceil(metrics.fDescent - metrics.fAscent +
+                                                2 * kPadding));
+
+        sk_sp<SkSurface> surface = pool.acquire(width, height);
+        SkCanvas* canvas = surface->getCanvas();
+        canvas->save();
+        canvas->clipRect(SkRect::MakeWH(width, height));
+        background.setColor(job.fBackground);
+        canvas->drawPaint(background);
+        text.setColor(job.fForeground);
+        canvas->drawSimpleText(job.fText.c_str(), job.fText.size(), SkTextEncoding::kUTF8,
+                               kPadding, kPadding - metrics.fAscent, *font, text);
+        canvas->restore();
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queue.push_back({std::move(surface), SkIRect::MakeWH(width, height),
+                             std::move(job.fOut)});
+        }
+        queueReady.notify_one();
+        badges++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        done = true;
+    }
+    queueReady.notify_all();
+    for (auto& t : encoders) {
+        t.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    size_t allocations = gAllocations.load() - allocationsBefore;
+
+    printf("%d badges written, %d failed, %d invalid jobs\n", written.load(), failed.load(),
+           invalid);
+    printf("%.0f badges/s on %d encode threads\n", badges / seconds, threads);
+    printf("%.1f allocations/badge, %d surfaces, %zu typefaces\n",
+           badges ? (double)allocations / badges : 0.0, pool.created(), fonts.typefaces());
+    return failed.load() || invalid ? 1 : 0;
+}
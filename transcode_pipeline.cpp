@@ -0,0 +1,441 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+// A staged image transcoder: decode -> resample -> encode.
+//
+// Each stage runs on its own set of threads and hands work to the next stage
+// through a bounded queue. Every decoded or resampled bitmap is charged against
+// a global memory budget; when the budget is exhausted the decoders block,
+// which is what keeps a fast decoder from flooding a slow encoder.
+//
+// At exit we print how busy each stage was, which tells you whether decode,
+// resample or encode is the bottleneck for a given corpus.
+
+#include "include/codec/SkCodec.h"
+#include "include/codec/SkGifDecoder.h"
+#include "include/codec/SkJpegDecoder.h"
+#include "include/codec/SkPngDecoder.h"
+#include "include/codec/SkWebpDecoder.h"
+#include "include/core/SkBitmap.h"
+#include "include/core/SkData.h"
+#include "include/core/SkImageInfo.h"
+#include "include/core/SkPixmap.h"
+#include "include/core/SkSamplingOptions.h"
+#include "include/core/SkStream.h"
+#include "include/encode/SkJpegEncoder.h"
+#include "include/encode/SkPngEncoder.h"
+#include "include/encode/SkWebpEncoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// A fixed-capacity multi-producer/multi-consumer queue. push() blocks while the
+// queue is full; pop() blocks while it is empty and returns nothing once the
+// queue has been closed and drained.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : fCapacity(std::max<size_t>(1, capacity)) {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(fMutex);
+        fNotFull.wait(lock, [this] { return fItems.size() < fCapacity; });
+        fItems.push_back(std::move(item));
+        fNotEmpty.notify_one();
+    }
+
+    std::optional<T> pop() {
+        std::unique_lock<std::mutex> lock(fMutex);
+        fNotEmpty.wait(lock, [this] { return !fItems.empty() || fClosed; });
+        if (fItems.empty()) {
+            return std::nullopt;
+        }
+        T item = std::move(fItems.front());
+        fItems.pop_front();
+        fNotFull.notify_one();
+        return item;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fClosed = true;
+        fNotEmpty.notify_all();
+    }
+
+private:
+    const size_t            fCapacity;
+    std::mutex              fMutex;
+    std::condition_variable fNotEmpty;
+    std::condition_variable fNotFull;
+    std::deque<T>           fItems;
+    bool                    fClosed = false;
+};
+
+// Global pixel memory budget. acquire() blocks until the requested bytes fit.
+// Only the decoders acquire, so backpressure is applied where new pixels enter
+// the pipeline. A single request larger than the whole budget is let through
+// once nothing else is outstanding, so one huge image cannot stall forever.
+class MemoryBudget {
+public:
+    explicit MemoryBudget(size_t limit) : fLimit(limit) {}
+
+    // Returns the time spent waiting, in nanoseconds.
+    int64_t acquire(size_t bytes) {
+        auto start = Clock::now();
+        std::unique_lock<std::mutex> lock(fMutex);
+        fReleased.wait(lock, [&] { return fInUse + bytes <= fLimit || fInUse == 0; });
+        fInUse += bytes;
+        fPeak = std::max(fPeak, fInUse);
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+
+    // Charges bytes without waiting. Used for allocations that replace a larger
+    // one already held, so that downstream stages can never block on the budget
+    // while holding memory that only they can release.
+    void charge(size_t bytes) {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fInUse += bytes;
+        fPeak = std::max(fPeak, fInUse);
+    }
+
+    void release(size_t bytes) {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fInUse -= std::min(bytes, fInUse);
+        fReleased.notify_all();
+    }
+
+    size_t peak() {
+        std::lock_guard<std::mutex> lock(fMutex);
+        return fPeak;
+    }
+
+private:
+    const size_t            fLimit;
+    std::mutex              fMutex;
+    std::condition_variable fReleased;
+    size_t                  fInUse = 0;
+    size_t                  fPeak = 0;
+};
+
+// Per-stage accounting. Busy time is the time spent doing the stage's actual
+// work; everything else is time spent blocked on a queue or on the budget. The
+// budget waits are also reported on their own.
+struct StageStats {
+    const char*            fName;
+    int                    fThreads;
+    std::atomic<int64_t>   fBusyNanos{0};
+    std::atomic<int64_t>   fBudgetWaitNanos{0};
+    std::atomic<int>       fItems{0};
+    std::atomic<int>       fFailures{0};
+
+    // Charges the time since start, less budgetWaitNanos spent blocked inside it.
+    void addBusy(Clock::time_point start, int64_t budgetWaitNanos = 0) {
+        fBusyNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - start).count() - budgetWaitNanos;
+        fBudgetWaitNanos += budgetWaitNanos;
+    }
+
+    void report(double wallSeconds) const {
+        double busy = fBusyNanos.load() * 1e-9;
+        double wait = fBudgetWaitNanos.load() * 1e-9;
+        double util = wallSeconds > 0 ? busy / (wallSeconds * fThreads) : 0;
+        printf("%-9s threads=%-2d items=%-5d failed=%-3d busy=%8.3fs utilization=%5.1f%% "
+               "budget_wait=%8.3fs\n",
+               fName, fThreads, fItems.load(), fFailures.load(), busy, 100.0 * util, wait);
+    }
+};
+
+enum class OutputFormat { kPNG, kJPEG, kWEBP };
+
+struct Job {
+    std::filesystem::path fInput;
+    SkBitmap              fBitmap;
+    size_t                fCharged = 0;   // bytes currently held against the budget
+};
+
+struct Options {
+    std::filesystem::path fInputDir;
+    std::filesystem::path fOutputDir;
+    int                   fDecodeThreads = 2;
+    int                   fResizeThreads = 2;
+    int                   fEncodeThreads = 2;
+    int                   fMaxDimension = 512;
+    size_t                fQueueDepth = 8;
+    size_t                fBudgetBytes = 256 << 20;
+    OutputFormat          fFormat = OutputFormat::kPNG;
+};
+
+static const char* extension_for(OutputFormat format) {
+    switch (format) {
+        case OutputFormat::kPNG:  return ".png";
+        case OutputFormat::kJPEG: return ".jpg";
+        case OutputFormat::kWEBP: return ".webp";
+    }
+    return "";
+}
+
+// *budgetWaitNanos is set to the time spent blocked on the budget.
+static bool decode(const std::filesystem::path& path, SkBitmap* bitmap, MemoryBudget* budget,
+                   size_t* charged, int64_t* budgetWaitNanos) {
+    *budgetWaitNanos = 0;
+    std::unique_ptr<SkFILEStream> input = SkFILEStream::Make(path.c_str());
+    if (!input || !input->isValid()) {
+        return false;
+    }
+    sk_sp<SkData> data = SkData::MakeFromStream(input.get(), input->getLength());
+    std::unique_ptr<SkCodec> codec = SkCodec::MakeFromData(std::move(data));
+    if (!codec) {
+        return false;
+    }
+
+    SkImageInfo info = codec->getInfo().makeColorType(kN32_SkColorType)
+                                       .makeAlphaType(kPremul_SkAlphaType);
+    *charged = info.computeMinByteSize();
+    *budgetWaitNanos = budget->acquire(*charged);
+    if (!bitmap->tryAllocPixels(info) ||
+        codec->getPixels(bitmap->pixmap()) != SkCodec::kSuccess) {
+        budget->release(*charged);
+        *charged = 0;
+        return false;
+    }
+    return true;
+}
+
+static bool resample(const SkBitmap& src, int maxDimension, SkBitmap* dst, MemoryBudget* budget,
+                     size_t* charged) {
+    int longest = std::max(src.width(), src.height());
+    if (maxDimension <= 0 || longest <= maxDimension) {
+        *dst = src;
+        return true;
+    }
+    float scale = static_cast<float>(maxDimension) / longest;
+    SkImageInfo info = src.info().makeWH(std::max(1, static_cast<int>(src.width() * scale)),
+                                         std::max(1, static_cast<int>(src.height() * scale)));
+    size_t bytes = info.computeMinByteSize();
+    budget->charge(bytes);
+    if (!dst->tryAllocPixels(info) ||
+        !src.pixmap().scalePixels(dst->pixmap(), SkSamplingOptions(SkCubicResampler::Mitchell()))) {
+        budget->release(bytes);
+        return false;
+    }
+    // The source pixels are dropped by the caller once we return.
+    budget->release(*charged);
+    *charged = bytes;
+    return true;
+}
+
+static bool encode(const SkPixmap& pixmap, OutputFormat format, const std::filesystem::path& out) {
+    SkFILEWStream output(out.c_str());
+    if (!output.isValid()) {
+        return false;
+    }
+    switch (format) {
+        case OutputFormat::kPNG:
+            return SkPngEncoder::Encode(&output, pixmap, {});
+        case OutputFormat::kJPEG: {
+            SkJpegEncoder::Options options;
+            options.fQuality = 90;
+            return SkJpegEncoder::Encode(&output, pixmap, options);
+        }
+        case OutputFormat::kWEBP: {
+            SkWebpEncoder::Options options;
+            options.fQuality = 90;
+            return SkWebpEncoder::Encode(&output, pixmap, options);
+        }
+    }
+    return false;
+}
+
+static bool parse_options(int argc, char** argv, Options* options) {
+    if (argc < 3) {
+        return false;
+    }
+    options->fInputDir = argv[1];
+    options->fOutputDir = argv[2];
+    for (int i = 3; i + 1 < argc; i += 2) {
+        const char* flag = argv[i];
+        const char* value = argv[i + 1];
+        if (!strcmp(flag, "--decode")) {
+            options->fDecodeThreads = std::max(1, atoi(value));
+        } else if (!strcmp(flag, "--resize")) {
+            options->fResizeThreads = std::max(1, atoi(value));
+        } else if (!strcmp(flag, "--encode")) {
+            options->fEncodeThreads = std::max(1, atoi(value));
+        } else if (!strcmp(flag, "--max-dim")) {
+            options->fMaxDimension = atoi(value);
+        } else if (!strcmp(flag, "--queue")) {
+            options->fQueueDepth = std::max(1, atoi(value));
+        } else if (!strcmp(flag, "--budget-mb")) {
+            options->fBudgetBytes = static_cast<size_t>(std::max(1, atoi(value))) << 20;
+        } else if (!strcmp(flag, "--format")) {
+            if (!strcmp(value, "png")) {
+                options->fFormat = OutputFormat::kPNG;
+            } else if (!strcmp(value, "jpeg") || !strcmp(value, "jpg")) {
+                options->fFormat = OutputFormat::kJPEG;
+            } else if (!strcmp(value, "webp")) {
+                options->fFormat = OutputFormat::kWEBP;
+            } else {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return (argc - 3) % 2 == 0;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, &options)) {
+        printf("Usage: %s <input dir> <output dir> [--decode N] [--resize N] [--encode N]\n"
+               "       [--max-dim PX] [--queue N] [--budget-mb MB] [--format png|jpeg|webp]\n",
+               argv[0]);
+        return 1;
+    }
+
+    SkCodecs::Register(SkGifDecoder::Decoder());
+    SkCodecs::Register(SkJpegDecoder::Decoder());
+    SkCodecs::Register(SkPngDecoder::Decoder());
+    SkCodecs::Register(SkWebpDecoder::Decoder());
+
+    std::error_code ec;
+    std::vector<std::filesystem::path> inputs;
+    for (const auto& entry : std::filesystem::directory_iterator(options.fInputDir, ec)) {
+        if (entry.is_regular_file()) {
+            inputs.push_back(entry.path());
+        }
+    }
+    if (ec) {
+        printf("Cannot read input directory %s\n", options.fInputDir.c_str());
+        return 1;
+    }
+    std::filesystem::create_directories(options.fOutputDir, ec);
+
+    MemoryBudget budget(options.fBudgetBytes);
+    BoundedQueue<std::filesystem::path> pathQueue(options.fQueueDepth);
+    BoundedQueue<std::unique_ptr<Job>> decodedQueue(options.fQueueDepth);
+    BoundedQueue<std::unique_ptr<Job>> resizedQueue(options.fQueueDepth);
+
+    StageStats decodeStats{"decode", options.fDecodeThreads};
+    StageStats resizeStats{"resample", options.fResizeThreads};
+    StageStats encodeStats{"encode", options.fEncodeThreads};
+
+    auto start = Clock::now();
+
+    std::thread feeder([&] {
+        for (const auto& path : inputs) {
+            pathQueue.push(path);
+        }
+        pathQueue.close();
+    });
+
+    std::vector<std::thread> decoders, resizers, encoders;
+    std::atomic<int> liveDecoders{options.fDecodeThreads};
+    std::atomic<int> liveResizers{options.fResizeThreads};
+
+    for (int i = 0; i < options.fDecodeThreads; ++i) {
+        decoders.emplace_back([&] {
+            while (auto path = pathQueue.pop()) {
+                auto job = std::make_unique<Job>();
+                job->fInput = *path;
+                auto t0 = Clock::now();
+                int64_t waitNanos;
+                bool ok = decode(job->fInput, &job->fBitmap, &budget, &job->fCharged,
+                                 &waitNanos);
+                decodeStats.addBusy(t0, waitNanos);
+                if (!ok) {
+                    decodeStats.fFailures++;
+                    continue;
+                }
+                decodeStats.fItems++;
+                decodedQueue.push(std::move(job));
+            }
+            if (--liveDecoders == 0) {
+                decodedQueue.close();
+            }
+        });
+    }
+
+    for (int i = 0; i < options.fResizeThreads; ++i) {
+        resizers.emplace_back([&] {
+            while (auto job = decodedQueue.pop()) {
+                auto t0 = Clock::now();
+                SkBitmap resized;
+                bool ok = resample((*job)->fBitmap, options.fMaxDimension, &resized, &budget,
+                                   &(*job)->fCharged);
+                resizeStats.addBusy(t0);
+                if (!ok) {
+                    resizeStats.fFailures++;
+                    budget.release((*job)->fCharged);
+                    continue;
+                }
+                (*job)->fBitmap = resized;
+                resizeStats.fItems++;
+                resizedQueue.push(std::move(*job));
+            }
+            if (--liveResizers == 0) {
+                resizedQueue.close();
+            }
+        });
+    }
+
+    for (int i = 0; i < options.fEncodeThreads; ++i) {
+        encoders.emplace_back([&] {
+            while (auto job = resizedQueue.pop()) {
+                // The whole source file name is kept (a.png -> a.png.webp), so that inputs
+                // which differ only in their extension do not overwrite each other.
+                std::filesystem::path out = options.fOutputDir / (*job)->fInput.filename();
+                out += extension_for(options.fFormat);
+                auto t0 = Clock::now();
+                bool ok = encode((*job)->fBitmap.pixmap(), options.fFormat, out);
+                encodeStats.addBusy(t0);
+                (*job)->fBitmap.reset();
+                budget.release((*job)->fCharged);
+                if (!ok) {
+                    encodeStats.fFailures++;
+                    continue;
+                }
+                encodeStats.fItems++;
+            }
+        });
+    }
+
+    feeder.join();
+    for (auto& t : decoders) { t.join(); }
+    for (auto& t : resizers) { t.join(); }
+    for (auto& t : encoders) { t.join(); }
+
+    double wall = seconds_since(start);
+    printf("Transcoded %d of %zu files in %.3fs (%.1f images/s), peak pixel memory %.1f MB\n",
+           encodeStats.fItems.load(), inputs.size(), wall,
+           wall > 0 ? encodeStats.fItems.load() / wall : 0.0,
+           budget.peak() / (1024.0 * 1024.0));
+    decodeStats.report(wall);
+    resizeStats.report(wall);
+    encodeStats.report(wall);
+
+    return encodeStats.fItems.load() == static_cast<int>(inputs.size()) ? 0 : 1;
+}
@@ -12,6 +12,9 @@
 #include "include/core/SkString.h"
 #include "modules/skresources/include/SkResources.h"
 
+#include "DecodedImageCache.h"
+#include "PrefetchingResourceProvider.h"
+
 #include <cstdio>
 #include <filesystem>
 
@@ -26,9 +29,14 @@ int main(int argc, char** argv) {
     SkCodecs::Register(SkPngDecoder::Decoder());
     auto frp = skresources::FileResourceProvider::Make(SkString(argv[1]));
 
+    // Decoded frames are shared between every asset (and thread) using this provider.
+    constexpr size_t kCacheBudget = 64 * 1024 * 1024;
+    auto cache = sk_make_sp<DecodedImageCache>(kCacheBudget);
+    auto crp = CachingImageResourceProvider::Make(frp, cache);
+
     // Try to load two arbitrary files in //resources/images
 
-    sk_sp<skresources::ImageAsset> asset = frp->loadImageAsset("images", "baby_tux.png", "");
+    sk_sp<skresources::ImageAsset> asset = crp->loadImageAsset("images", "baby_tux.png", "");
     if (!asset) {
         printf("Could not load baby_tux.png in images subdirectory\n");
         return 1;
@@ -40,7 +48,7 @@ int main(int argc, char** argv) {
     }
     printf("Baby Tux is %d by %d pixels big\n", tux->width(), tux->height());
 
-    asset = frp->loadImageAsset("images", "CMYK.jpg", "");
+    asset = crp->loadImageAsset("images", "CMYK.jpg", "");
     if (!asset || !asset->getFrameData(0).image) {
         printf("Could not load/decode CMYK.jpg in images subdirectory\n");
         return 1;
@@ -53,5 +61,27 @@ int main(int argc, char** argv) {
     }
     printf("CMYK is %d by %d pixels big\n", cmyk->width(), cmyk->height());
 
+    // Skottie and SVG documents commonly reference the same image many times over.
+    for (int i = 0; i < 100; ++i) {
+        asset = crp->loadImageAsset("images", "baby_tux.png", "");
+        if (!asset || asset->getFrameData(0).image != tux) {
+            printf("Cached baby_tux.png did not come back from the cache\n");
+            return 1;
+        }
+    }
+    DecodedImageCache::Stats stats = cache->stats();
+    printf("Image cache: %d hits, %d misses, %zu of %zu bytes used\n",
+           stats.fHits, stats.fMisses, stats.fBytes, stats.fBudget);
+
+    // Start decoding on background threads; loadImageAsset() then returns at once, and
+    // only getFrameData() waits if the decode is still running.
+    auto prp = PrefetchingResourceProvider::Make(frp);
+    prp->prefetch({{"images", "mandrill_512.png"}, {"images", "color_wheel.jpg"}});
+    asset = prp->loadImageAsset("images", "mandrill_512.png", "");
+    if (sk_sp<SkImage> mandrill = asset->getFrameData(0).image) {
+        printf("Mandrill is %d by %d pixels big (%d stalled draws)\n",
+               mandrill->width(), mandrill->height(), prp->stalls());
+    }
+
     return 0;
 }
@@ -5,14 +5,234 @@
  * found in the LICENSE file.
  */
 
+#include "include/core/SkBitmap.h"
 #include "include/core/SkCanvas.h"
 #include "include/core/SkData.h"
+#include "include/core/SkFont.h"
 #include "include/core/SkImage.h"
-#include "modules/skresources/include/SkResources.h"
+#include "include/core/SkImageInfo.h"
+#include "include/private/base/SkTPin.h"
 #include "tools/Resources.h"
+#include "tools/fonts/FontToolUtils.h"
 #include "tools/viewer/AnimatedImageSlide.h"
 #include <cmath>
 
+// Upper bound on memory spent keeping "required" frames around for seeking.
+static constexpr size_t kKeyframeBudget = 64 * 1024 * 1024;
+static constexpr int    kDefaultDecodeAhead = 4;
+
+std::unique_ptr<AnimatedFrameProvider> AnimatedFrameProvider::Make(sk_sp<SkData> data,
+                                                                   int decodeAhead) {
+    if (!data) {
+        return nullptr;
+    }
+    std::unique_ptr<SkCodec> codec = SkCodec::MakeFromData(std::move(data));
+    if (!codec) {
+        return nullptr;
+    }
+    return std::unique_ptr<AnimatedFrameProvider>(
+            new AnimatedFrameProvider(std::move(codec), decodeAhead));
+}
+
+AnimatedFrameProvider::AnimatedFrameProvider(std::unique_ptr<SkCodec> codec, int decodeAhead)
+    : fCodec(std::move(codec))
+    , fFrameInfo(fCodec->getFrameInfo())
+    , fIsKeyframe(std::max<size_t>(1, fFrameInfo.size()), false)
+    , fDecodeAhead(SkTPin(decodeAhead, 0, std::max(0, this->frameCount() - 1))) {
+    for (const SkCodec::FrameInfo& info : fFrameInfo) {
+        fDuration += info.fDuration;
+        if (info.fRequiredFrame != SkCodec::kNoFrame) {
+            fIsKeyframe[info.fRequiredFrame] = true;
+        }
+    }
+    fWorker = std::thread([this] { this->workerLoop(); });
+}
+
+AnimatedFrameProvider::~AnimatedFrameProvider() {
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fQuit = true;
+    }
+    fWorkAvailable.notify_all();
+    fFrameReady.notify_all();
+    fWorker.join();
+}
+
+int AnimatedFrameProvider::frameForTime(double ms) const {
+    if (this->frameCount() <= 1) {
+        return 0;
+    }
+    for (int i = 0; i < this->frameCount(); ++i) {
+        ms -= fFrameInfo[i].fDuration;
+        if (ms < 0) {
+            return i;
+        }
+    }
+    return this->frameCount() - 1;
+}
+
+bool AnimatedFrameProvider::findLocked(int index, sk_sp<SkImage>* image) const {
+    if (auto it = fAhead.find(index); it != fAhead.end()) {
+        *image = it->second;
+        return true;
+    }
+    if (auto it = fKeyframes.find(index); it != fKeyframes.end()) {
+        *image = it->second;
+        return true;
+    }
+    return false;
+}
+
+bool AnimatedFrameProvider::inWindowLocked(int index) const {
+    int n = std::max(1, this->frameCount());
+    int distance = (index - fCurrent + n) % n;
+    return distance <= fDecodeAhead || index == fDemand;
+}
+
+void AnimatedFrameProvider::storeLocked(int index, sk_sp<SkImage> image) {
+    if (fIsKeyframe[index] && image && !fKeyframes.count(index)) {
+        size_t bytes = image->imageInfo().computeMinByteSize();
+        if (fKeyframeBytes + bytes <= kKeyframeBudget) {
+            fKeyframes[index] = image;
+            fKeyframeBytes += bytes;
+            return;
+        }
+    }
+    if (this->inWindowLocked(index)) {
+        fAhead[index] = std::move(image);
+    }
+}
+
+void AnimatedFrameProvider::trimLocked() {
+    for (auto it = fAhead.begin(); it != fAhead.end();) {
+        it = this->inWindowLocked(it->first) ? std::next(it) : fAhead.erase(it);
+    }
+}
+
+sk_sp<SkImage> AnimatedFrameProvider::getFrame(int index) {
+    index = SkTPin(index, 0, std::max(0, this->frameCount() - 1));
+
+    std::unique_lock<std::mutex> lock(fMutex);
+    fCurrent = index;
+    this->trimLocked();
+
+    sk_sp<SkImage> image;
+    if (!this->findLocked(index, &image)) {
+        ++fStalls;
+        fDemand = index;
+        fWorkAvailable.notify_one();
+        fFrameReady.wait(lock, [&] { return fQuit || this->findLocked(index, &image); });
+    } else {
+        // Let the worker refill the window behind the frame we just consumed.
+        fWorkAvailable.notify_one();
+    }
+    return image;
+}
+
+int AnimatedFrameProvider::nextToDecodeLocked() const {
+    sk_sp<SkImage> unused;
+    if (fDemand >= 0 && !this->findLocked(fDemand, &unused)) {
+        return fDemand;
+    }
+    int n = std::max(1, this->frameCount());
+    for (int d = 0; d <= fDecodeAhead; ++d) {
+        int index = (fCurrent + d) % n;
+        if (!this->findLocked(index, &unused)) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+sk_sp<SkImage> AnimatedFrameProvider::decodeFrame(int index, std::unique_lock<std::mutex>* lock) {
+    SkCodec::Options options;
+    options.fFrameIndex = index;
+
+    sk_sp<SkImage> prior;
+    int required = index < static_cast<int>(fFrameInfo.size())
+                           ? fFrameInfo[index].fRequiredFrame
+                           : SkCodec::kNoFrame;
+    if (required != SkCodec::kNoFrame && !this->findLocked(required, &prior)) {
+        // Decode (and keep) the frame we depend on first, so later seeks can start from it.
+        prior = this->decodeFrame(required, lock);
+        this->storeLocked(required, prior);
+    }
+
+    lock->unlock();
+    SkImageInfo info = fCodec->getInfo().makeColorType(kN32_SkColorType)
+                                        .makeAlphaType(kPremul_SkAlphaType);
+    SkBitmap bitmap;
+    sk_sp<SkImage> image;
+    if (bitmap.tryAllocPixels(info)) {
+        if (prior && prior->readPixels(nullptr, bitmap.pixmap(), 0, 0)) {
+            options.fPriorFrame = required;
+        }
+        SkCodec::Result result = fCodec->getPixels(bitmap.pixmap(), &options);
+        if (result == SkCodec::kSuccess || result == SkCodec::kIncompleteInput ||
+            result == SkCodec::kErrorInInput) {
+            bitmap.setImmutable();
+            image = bitmap.asImage();
+        }
+    }
+    lock->lock();
+    return image;
+}
+
+void AnimatedFrameProvider::workerLoop() {
+    std::unique_lock<std::mutex> lock(fMutex);
+    while (!fQuit) {
+        int index = this->nextToDecodeLocked();
+        if (index < 0) {
+            fWorkAvailable.wait(lock);
+            continue;
+        }
+        // A failed decode is stored as a null frame, so we do not retry it forever.
+        sk_sp<SkImage> image = this->decodeFrame(index, &lock);
+        bool demanded = index == fDemand;
+        if (demanded) {
+            fAhead[index] = image;
+            fDemand = -1;
+        }
+        this->storeLocked(index, std::move(image));
+        if (demanded) {
+            fFrameReady.notify_all();
+        }
+    }
+}
+
+void AnimatedFrameProvider::setDecodeAhead(int decodeAhead) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fDecodeAhead = SkTPin(decodeAhead, 0, std::max(0, this->frameCount() - 1));
+    this->trimLocked();
+    fWorkAvailable.notify_one();
+}
+
+int AnimatedFrameProvider::decodeAhead() const {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fDecodeAhead;
+}
+
+int AnimatedFrameProvider::readyAhead() const {
+    std::lock_guard<std::mutex> lock(fMutex);
+    int n = std::max(1, this->frameCount());
+    sk_sp<SkImage> unused;
+    int ready = 0;
+    for (int d = 1; d <= fDecodeAhead && this->findLocked((fCurrent + d) % n, &unused); ++d) {
+        ++ready;
+    }
+    return ready;
+}
+
+int AnimatedFrameProvider::stalls() const {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fStalls;
+}
+
+int AnimatedFrameProvider::keyframes() const {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return static_cast<int>(fKeyframes.size());
+}
+
 AnimatedImageSlide::AnimatedImageSlide(const SkString& name, const SkString& path)
     : fPath(path)
 {
@@ -28,38 +248,51 @@ void AnimatedImageSlide::load(SkScalar w, SkScalar h) {
         data = SkData::MakeFromFileName(fPath.c_str());
     }
 
-    fImageAsset = skresources::MultiFrameImageAsset::Make(std::move(data));
+    fFrames = AnimatedFrameProvider::Make(std::move(data), kDefaultDecodeAhead);
 }
 
 void AnimatedImageSlide::unload() {
-    fImageAsset.reset();
+    fFrames.reset();
     fTimeBase = 0;
 }
 
 void AnimatedImageSlide::draw(SkCanvas* canvas) {
-    if (!fImageAsset) {
+    if (!fFrames) {
+        return;
+    }
+
+    sk_sp<SkImage> frame = fFrames->getFrame(fFrames->frameForTime(fFrameMs));
+    if (!frame) {
         return;
     }
 
-    sk_sp<SkImage> frame = fImageAsset->getFrame(fFrameMs * 0.001f);
+    {
+        SkAutoCanvasRestore acr(canvas, true);
+        canvas->translate((fWinSize.width() - frame->width()) / 2,
+                          (fWinSize.height() - frame->height()) / 2);
 
-    SkAutoCanvasRestore acr(canvas, true);
-    canvas->translate((fWinSize.width() - frame->width()) / 2,
-                      (fWinSize.height() - frame->height()) / 2);
+        SkPaint outline_paint;
+        outline_paint.setAntiAlias(true);
+        outline_paint.setColor(0x80000000);
+        outline_paint.setStyle(SkPaint::kStroke_Style);
 
-    SkPaint outline_paint;
-    outline_paint.setAntiAlias(true);
-    outline_paint.setColor(0x80000000);
-    outline_paint.setStyle(SkPaint::kStroke_Style);
+        const SkRect outline = SkRect::Make(frame->bounds()).makeOutset(1, 1);
+        canvas->drawRect(outline, outline_paint);
 
-    const SkRect outline = SkRect::Make(frame->bounds()).makeOutset(1, 1);
-    canvas->drawRect(outline, outline_paint);
+        canvas->drawImage(frame, 0, 0);
+    }
 
-    canvas->drawImage(frame, 0, 0);
+    SkFont font = ToolUtils::DefaultFont();
+    SkPaint text_paint;
+    text_paint.setAntiAlias(true);
+    canvas->drawString(SkStringPrintf("decode-ahead %d/%d ('+'/'-')  stalls %d  keyframes %d",
+                                      fFrames->readyAhead(), fFrames->decodeAhead(),
+                                      fFrames->stalls(), fFrames->keyframes()),
+                       10, 20, font, text_paint);
 }
 
 bool AnimatedImageSlide::animate(double nanos) {
-    if (!fImageAsset || !fImageAsset->isMultiFrame()) {
+    if (!fFrames || fFrames->frameCount() <= 1 || fFrames->duration() <= 0) {
         return false;
     }
 
@@ -67,10 +300,22 @@ bool AnimatedImageSlide::animate(double nanos) {
         fTimeBase = nanos;
     }
 
-    fFrameMs = std::fmod((nanos - fTimeBase) * 0.000001f, fImageAsset->duration());
+    fFrameMs = std::fmod((nanos - fTimeBase) * 0.000001f, fFrames->duration());
 
     return true;
 }
 
+bool AnimatedImageSlide::onChar(SkUnichar c) {
+    if (!fFrames) {
+        return false;
+    }
+    switch (c) {
+        case '+': fFrames->setDecodeAhead(fFrames->decodeAhead() + 1); return true;
+        case '-': fFrames->setDecodeAhead(fFrames->decodeAhead() - 1); return true;
+        default: break;
+    }
+    return false;
+}
+
 DEF_SLIDE( return new AnimatedImageSlide(SkString("AnimatedImage"),
                                          SkString("images/alphabetAnim.gif")); )
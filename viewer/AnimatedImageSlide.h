@@ -8,11 +8,79 @@
 #ifndef AnimatedImageSlide_DEFINED
 #define AnimatedImageSlide_DEFINED
 
+#include "include/codec/SkCodec.h"
+#include "include/core/SkImage.h"
 #include "include/core/SkString.h"
-#include "modules/skresources/include/SkResources.h"
 #include "tools/viewer/Slide.h"
 
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 class SkCanvas;
+class SkData;
+
+/**
+ *  Decodes the frames of an animated image on a worker thread, keeping up to a configurable
+ *  number of frames ready ahead of the one currently displayed.
+ *
+ *  Frames that other frames depend on (SkCodec::FrameInfo::fRequiredFrame) are kept in a
+ *  separate keyframe cache, so a seek costs at most one dependent decode once the required
+ *  frame has been seen.
+ */
+class AnimatedFrameProvider {
+public:
+    static std::unique_ptr<AnimatedFrameProvider> Make(sk_sp<SkData>, int decodeAhead);
+    ~AnimatedFrameProvider();
+
+    int frameCount() const { return std::max(1, static_cast<int>(fFrameInfo.size())); }
+    double duration() const { return fDuration; }
+    int frameForTime(double ms) const;
+
+    /** Returns the given frame, blocking (and counting a stall) if it is not decoded yet. */
+    sk_sp<SkImage> getFrame(int index);
+
+    void setDecodeAhead(int);
+    int decodeAhead() const;
+    /** Number of frames after the current one that are already decoded. */
+    int readyAhead() const;
+    int stalls() const;
+    int keyframes() const;
+
+private:
+    AnimatedFrameProvider(std::unique_ptr<SkCodec>, int decodeAhead);
+
+    void workerLoop();
+    int nextToDecodeLocked() const;
+    sk_sp<SkImage> decodeFrame(int index, std::unique_lock<std::mutex>*);
+    bool findLocked(int index, sk_sp<SkImage>*) const;
+    bool inWindowLocked(int index) const;
+    void storeLocked(int index, sk_sp<SkImage>);
+    void trimLocked();
+
+    const std::unique_ptr<SkCodec>          fCodec;      // only used by the worker
+    const std::vector<SkCodec::FrameInfo>   fFrameInfo;
+    std::vector<bool>                       fIsKeyframe;
+    double                                  fDuration = 0;
+
+    mutable std::mutex                      fMutex;
+    std::condition_variable                 fWorkAvailable;
+    std::condition_variable                 fFrameReady;
+    std::map<int, sk_sp<SkImage>>           fAhead;
+    std::map<int, sk_sp<SkImage>>           fKeyframes;
+    size_t                                  fKeyframeBytes = 0;
+    int                                     fCurrent = 0;
+    int                                     fDemand = -1;
+    int                                     fDecodeAhead;
+    int                                     fStalls = 0;
+    bool                                    fQuit = false;
+
+    std::thread                             fWorker;
+};
 
 class AnimatedImageSlide final : public Slide {
 public:
@@ -23,10 +91,11 @@ public:
 
     void draw(SkCanvas*) override;
     bool animate(double nanos) override;
+    bool onChar(SkUnichar) override;
 
 private:
     const SkString                           fPath;
-    sk_sp<skresources::MultiFrameImageAsset> fImageAsset;
+    std::unique_ptr<AnimatedFrameProvider>   fFrames;
     SkSize                                   fWinSize;
 
     double                                   fTimeBase = 0;
@@ -4,14 +4,32 @@
  * Use of this source code is governed by a BSD-style license that can be
  * found in the LICENSE file.
  */
+#include "include/core/SkBlendMode.h"
 #include "include/core/SkCanvas.h"
+#include "include/core/SkFont.h"
+#include "include/core/SkImage.h"
 #include "include/core/SkPaint.h"
+#include "include/core/SkPath.h"
+#include "include/core/SkRSXform.h"
 #include "include/core/SkShader.h"
+#include "include/core/SkString.h"
+#include "include/core/SkSurface.h"
+#include "include/core/SkVertices.h"
+#include "include/private/base/SkTPin.h"
 #include "src/base/SkRandom.h"
+#include "src/base/SkTime.h"
+#include "tools/fonts/FontToolUtils.h"
 #include "tools/viewer/Slide.h"
 
+#include <vector>
+
 /**
  * Animated sample used to develop a predecessor of GrDrawOp combining.
+ *
+ * The same random rects can be submitted in several ways ('m' cycles through them, '+' and '-'
+ * change the count by 10x), and the CPU time spent submitting them is shown in the corner.
+ * Colors come from a small palette so that the per-color merged paths mode has something to
+ * merge.
  */
 class ManyRectsSlide : public Slide {
 private:
@@ -19,27 +37,94 @@ private:
         N = 1000,
     };
 
+    enum class Mode {
+        kDrawRect,     // one drawRect per rect, each with its own translate and clip
+        kAtlas,        // one drawAtlas, with a per-sprite color modulating a white atlas
+        kVertices,     // one SkVertices triangle list with per-vertex colors
+        kMergedPaths,  // one path per palette color
+
+        kLast = kMergedPaths,
+    };
+
+    static constexpr int kColorCount = 16;
+    static constexpr int kMaxRectSize = 100;
+
 public:
-    ManyRectsSlide() { fName = "ManyRects"; }
+    ManyRectsSlide() {
+        fName = "ManyRects";
+        for (SkColor& color : fPalette) {
+            color = fRandom.nextU();
+        }
+    }
+
+    bool onChar(SkUnichar uni) override {
+        switch (uni) {
+            case 'm':
+                fMode = fMode == Mode::kLast ? Mode::kDrawRect
+                                             : static_cast<Mode>(static_cast<int>(fMode) + 1);
+                fSubmitMs = 0;
+                return true;
+            case '+':
+            case '=':
+                fCount = SkTPin(fCount * 10, 10, 1000000);
+                fSubmitMs = 0;
+                return true;
+            case '-':
+            case '_':
+                fCount = SkTPin(fCount / 10, 10, 1000000);
+                fSubmitMs = 0;
+                return true;
+        }
+        return false;
+    }
 
     void draw(SkCanvas* canvas) override {
         SkISize dsize = canvas->getBaseLayerSize();
         canvas->clear(0xFFF0E0F0);
 
-        for (int i = 0; i < N; ++i) {
-            SkRect rect = SkRect::MakeWH(SkIntToScalar(fRandom.nextRangeU(10, 100)),
-                                         SkIntToScalar(fRandom.nextRangeU(10, 100)));
+        fRects.resize(fCount);
+        fColors.resize(fCount);
+        fColorIndices.resize(fCount);
+        for (int i = 0; i < fCount; ++i) {
+            SkRect rect = SkRect::MakeWH(SkIntToScalar(fRandom.nextRangeU(10, kMaxRectSize)),
+                                         SkIntToScalar(fRandom.nextRangeU(10, kMaxRectSize)));
             int x = fRandom.nextRangeU(0, dsize.fWidth);
             int y = fRandom.nextRangeU(0, dsize.fHeight);
+            fRects[i] = rect.makeOffset(SkIntToScalar(x), SkIntToScalar(y));
+            fColorIndices[i] = fRandom.nextULessThan(kColorCount);
+            fColors[i] = fPalette[fColorIndices[i]];
+        }
+
+        // Only the submission is timed. On the GPU backends this is the cost of recording the
+        // draws; the flush is part of the frame time in the stats overlay.
+        double start = SkTime::GetMSecs();
+        switch (fMode) {
+            case Mode::kDrawRect:    this->drawRects(canvas);    break;
+            case Mode::kAtlas:       this->drawAtlas(canvas);    break;
+            case Mode::kVertices:    this->drawVertices(canvas); break;
+            case Mode::kMergedPaths: this->drawPaths(canvas);    break;
+        }
+        double ms = SkTime::GetMSecs() - start;
+        fSubmitMs = fSubmitMs ? 0.9 * fSubmitMs + 0.1 * ms : ms;
+
+        this->drawStatus(canvas);
+    }
+
+private:
+    void drawRects(SkCanvas* canvas) {
+        for (int i = 0; i < fCount; ++i) {
+            SkRect rect = SkRect::MakeWH(fRects[i].width(), fRects[i].height());
+            SkScalar x = fRects[i].fLeft;
+            SkScalar y = fRects[i].fTop;
             canvas->save();
 
-            canvas->translate(SkIntToScalar(x), SkIntToScalar(y));
+            canvas->translate(x, y);
             // Uncomment to test rotated rect draw combining.
             if ((false)) {
                 SkMatrix rotate;
                 rotate.setRotate(fRandom.nextUScalar1() * 360,
-                                 SkIntToScalar(x) + SkScalarHalf(rect.fRight),
-                                 SkIntToScalar(y) + SkScalarHalf(rect.fBottom));
+                                 x + SkScalarHalf(rect.fRight),
+                                 y + SkScalarHalf(rect.fBottom));
                 canvas->concat(rotate);
             }
             SkRect clipRect = rect;
@@ -48,14 +133,92 @@ public:
             clipRect.outset(10, 10);
             canvas->clipRect(clipRect);
             SkPaint paint;
-            paint.setColor(fRandom.nextU());
+            paint.setColor(fColors[i]);
             canvas->drawRect(rect, paint);
             canvas->restore();
         }
     }
 
-private:
+    void drawAtlas(SkCanvas* canvas) {
+        if (!fAtlas) {
+            sk_sp<SkSurface> surface =
+                    SkSurfaces::Raster(SkImageInfo::MakeN32Premul(kMaxRectSize, kMaxRectSize));
+            surface->getCanvas()->clear(SK_ColorWHITE);
+            fAtlas = surface->makeImageSnapshot();
+        }
+        fXforms.resize(fCount);
+        fTexRects.resize(fCount);
+        for (int i = 0; i < fCount; ++i) {
+            fXforms[i] = SkRSXform::Make(1, 0, fRects[i].fLeft, fRects[i].fTop);
+            fTexRects[i] = SkRect::MakeWH(fRects[i].width(), fRects[i].height());
+        }
+        canvas->drawAtlas(fAtlas.get(), fXforms.data(), fTexRects.data(), fColors.data(), fCount,
+                          SkBlendMode::kModulate, SkSamplingOptions(), nullptr, nullptr);
+    }
+
+    void drawVertices(SkCanvas* canvas) {
+        // Unindexed, since 16-bit indices cannot address more than ~16k rects.
+        SkVertices::Builder builder(SkVertices::kTriangles_VertexMode, 6 * fCount, 0,
+                                    SkVertices::kHasColors_BuilderFlag);
+        SkPoint* pos = builder.positions();
+        SkColor* colors = builder.colors();
+        for (int i = 0; i < fCount; ++i) {
+            const SkRect& r = fRects[i];
+            const SkPoint quad[6] = {{r.fLeft, r.fTop}, {r.fRight, r.fTop},
+                                     {r.fLeft, r.fBottom}, {r.fRight, r.fTop},
+                                     {r.fRight, r.fBottom}, {r.fLeft, r.fBottom}};
+            for (int v = 0; v < 6; ++v) {
+                *pos++ = quad[v];
+                *colors++ = fColors[i];
+            }
+        }
+        canvas->drawVertices(builder.detach(), SkBlendMode::kModulate, SkPaint());
+    }
+
+    void drawPaths(SkCanvas* canvas) {
+        for (SkPath& path : fPaths) {
+            path.rewind();
+        }
+        for (int i = 0; i < fCount; ++i) {
+            fPaths[fColorIndices[i]].addRect(fRects[i]);
+        }
+        SkPaint paint;
+        for (int c = 0; c < kColorCount; ++c) {
+            paint.setColor(fPalette[c]);
+            canvas->drawPath(fPaths[c], paint);
+        }
+    }
+
+    void drawStatus(SkCanvas* canvas) {
+        static const char* kModeNames[] = {"drawRect", "drawAtlas", "drawVertices",
+                                           "merged paths"};
+        SkString status;
+        status.printf("%s: %d rects, %.3f ms to submit  (m: mode, +/-: count)",
+                      kModeNames[static_cast<int>(fMode)], fCount, fSubmitMs);
+        SkFont font(ToolUtils::DefaultPortableTypeface(), 16);
+        SkRect bounds;
+        font.measureText(status.c_str(), status.size(), SkTextEncoding::kUTF8, &bounds);
+        SkPaint paint;
+        paint.setColor(0xC0FFFFFF);
+        canvas->drawRect(SkRect::MakeXYWH(4, 4, bounds.width() + 12, 24), paint);
+        paint.setColor(SK_ColorBLACK);
+        canvas->drawString(status, 10, 22, font, paint);
+    }
+
     SkRandom fRandom;
+    SkColor fPalette[kColorCount];
+    Mode fMode = Mode::kDrawRect;
+    int fCount = N;
+    double fSubmitMs = 0;
+
+    // Per-frame workload, shared by all modes, and per-mode scratch kept between frames.
+    std::vector<SkRect> fRects;
+    std::vector<SkColor> fColors;
+    std::vector<uint8_t> fColorIndices;  // into fPalette
+    sk_sp<SkImage> fAtlas;
+    std::vector<SkRSXform> fXforms;
+    std::vector<SkRect> fTexRects;
+    SkPath fPaths[kColorCount];
 };
 
 //////////////////////////////////////////////////////////////////////////////
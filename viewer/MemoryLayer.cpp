@@ -0,0 +1,249 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "tools/viewer/MemoryLayer.h"
+
+#include "include/core/SkCanvas.h"
+#include "include/core/SkFont.h"
+#include "include/core/SkGraphics.h"
+#include "include/core/SkMatrix.h"
+#include "include/core/SkPaint.h"
+#include "include/core/SkRect.h"
+#include "include/core/SkString.h"
+#include "include/core/SkSurface.h"
+#include "include/core/SkTypeface.h"
+#include "tools/fonts/FontToolUtils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(memory_sanitizer) || \
+    __has_feature(thread_sanitizer)
+#define MEMORY_LAYER_SANITIZED
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define MEMORY_LAYER_SANITIZED
+#endif
+
+namespace {
+std::atomic<uint64_t> gAllocCount{0};
+std::atomic<uint64_t> gAllocBytes{0};
+
+inline void count_allocation(size_t size) {
+    gAllocCount.fetch_add(1, std::memory_order_relaxed);
+    gAllocBytes.fetch_add(size, std::memory_order_relaxed);
+}
+}  // namespace
+
+#if defined(__GLIBC__) && !defined(MEMORY_LAYER_SANITIZED)
+#define MEMORY_LAYER_COUNTS_ALLOCATIONS
+
+// glibc's own entry points, which the definitions below forward to. glibc expects a program
+// that replaces malloc to replace the whole family together, so every allocating entry point
+// is defined here, and free() is forwarded too so that releases go to the same allocator.
+// operator new (including the aligned forms), sk_malloc and the C libraries Skia links all
+// end up in one of these, so this sees every heap allocation made through the C allocator.
+extern "C" {
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+void* __libc_memalign(size_t, size_t);
+void* __libc_valloc(size_t);
+void* __libc_pvalloc(size_t);
+void __libc_free(void*);
+
+void* malloc(size_t size) {
+    count_allocation(size);
+    return __libc_malloc(size);
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+void* calloc(size_t count, size_t size) {
+    size_t bytes;
+    if (!__builtin_mul_overflow(count, size, &bytes)) {
+        count_allocation(bytes);
+    }
+    // On overflow glibc fails the request with ENOMEM.
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    count_allocation(size);
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    count_allocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    count_allocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** result, size_t alignment, size_t size) {
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0 || alignment == 0) {
+        return EINVAL;
+    }
+    count_allocation(size);
+    void* ptr = __libc_memalign(alignment, size);
+    if (!ptr && size != 0) {
+        return ENOMEM;
+    }
+    *result = ptr;
+    return 0;
+}
+
+void* valloc(size_t size) {
+    count_allocation(size);
+    return __libc_valloc(size);
+}
+
+void* pvalloc(size_t size) {
+    count_allocation(size);
+    return __libc_pvalloc(size);
+}
+}
+#endif
+
+bool MemoryLayer::CountsAllocations() {
+#if defined(MEMORY_LAYER_COUNTS_ALLOCATIONS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Resident set size in bytes, or 0 where it cannot be read.
+static size_t resident_bytes() {
+#if defined(__linux__)
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (!statm) {
+        return 0;
+    }
+    long pages = 0, resident = 0;
+    int fields = fscanf(statm, "%ld %ld", &pages, &resident);
+    fclose(statm);
+    return fields == 2 ? static_cast<size_t>(resident) * sysconf(_SC_PAGESIZE) : 0;
+#else
+    return 0;
+#endif
+}
+
+MemoryLayer::MemoryLayer()
+    : fLastAllocCount(0)
+    , fLastAllocBytes(0)
+    , fCurrentMeasurement(-1)
+    , fMeasuredFrames(0)
+    , fDisplayScale(1.0f) {
+    this->resetMeasurements();
+}
+
+void MemoryLayer::resetMeasurements() {
+    memset(fAllocCounts, 0, sizeof(fAllocCounts));
+    memset(fAllocBytes, 0, sizeof(fAllocBytes));
+    fCurrentMeasurement = -1;
+    fMeasuredFrames = 0;
+}
+
+void MemoryLayer::onPrePaint() {
+    // Everything allocated since the last call, across all threads, is charged to the frame
+    // that just ended.
+    uint64_t count = gAllocCount.load(std::memory_order_relaxed);
+    uint64_t bytes = gAllocBytes.load(std::memory_order_relaxed);
+    if (fCurrentMeasurement >= 0) {
+        fAllocCounts[fCurrentMeasurement] = count - fLastAllocCount;
+        fAllocBytes[fCurrentMeasurement] = bytes - fLastAllocBytes;
+        fMeasuredFrames = std::min(fMeasuredFrames + 1, kMeasurementCount);
+    }
+    fLastAllocCount = count;
+    fLastAllocBytes = bytes;
+    fCurrentMeasurement = (fCurrentMeasurement + 1) & (kMeasurementCount - 1);
+}
+
+void MemoryLayer::onPaint(SkSurface* surface) {
+#ifdef SK_BUILD_FOR_ANDROID
+    // Scale up the overlay on Android devices
+    static constexpr SkScalar kScale = 1.5;
+#else
+    SkScalar kScale = fDisplayScale;
+#endif
+    static const int kDisplayWidth = 330;
+    static const int kLineHeight = 14;
+    static const int kLineCount = 7;
+    static const int kDisplayPadding = 10;
+    static const double kMB = 1024.0 * 1024.0;
+
+    auto canvas = surface->getCanvas();
+    SkRect rect = SkRect::MakeXYWH(kDisplayPadding, kDisplayPadding, kDisplayWidth,
+                                   kLineCount * kLineHeight + 6);
+    SkAutoCanvasRestore acr(canvas, /*doSave=*/true);
+
+    // Scale the canvas while keeping the left edge in place.
+    canvas->concat(SkMatrix::Scale(kScale, kScale));
+
+    SkPaint paint;
+    paint.setColor(SK_ColorBLACK);
+    canvas->drawRect(rect, paint);
+
+    // The last complete frame, and the mean and max over the history.
+    int last = (fCurrentMeasurement - 1) & (kMeasurementCount - 1);
+    uint64_t sumCount = 0, sumBytes = 0, maxCount = 0, maxBytes = 0;
+    for (int i = 0; i < kMeasurementCount; ++i) {
+        sumCount += fAllocCounts[i];
+        sumBytes += fAllocBytes[i];
+        maxCount = std::max(maxCount, fAllocCounts[i]);
+        maxBytes = std::max(maxBytes, fAllocBytes[i]);
+    }
+    int frames = std::max(1, fMeasuredFrames);
+
+    SkFont font(ToolUtils::CreatePortableTypeface("sans-serif", SkFontStyle()), 14);
+    paint.setColor(SK_ColorWHITE);
+    SkScalar x = rect.fLeft + 3;
+    SkScalar y = rect.fTop;
+    auto drawLine = [&](const SkString& text) {
+        y += kLineHeight;
+        canvas->drawString(text, x, y, font, paint);
+    };
+
+    size_t rss = resident_bytes();
+    drawLine(rss ? SkStringPrintf("RSS: %.1f MB", rss / kMB) : SkString("RSS: n/a"));
+    drawLine(SkStringPrintf("Font cache: %.1f / %.1f MB",
+                            SkGraphics::GetFontCacheUsed() / kMB,
+                            SkGraphics::GetFontCacheLimit() / kMB));
+    drawLine(SkStringPrintf("Glyph caches: %d / %d",
+                            SkGraphics::GetFontCacheCountUsed(),
+                            SkGraphics::GetFontCacheCountLimit()));
+    drawLine(SkStringPrintf("Resource cache: %.1f / %.1f MB",
+                            SkGraphics::GetResourceCacheTotalBytesUsed() / kMB,
+                            SkGraphics::GetResourceCacheTotalByteLimit() / kMB));
+    if (!CountsAllocations()) {
+        drawLine(SkString("Allocations: not counted in this build"));
+        return;
+    }
+    drawLine(SkStringPrintf("Allocs/frame: %llu last, %.0f avg, %llu max",
+                            (unsigned long long)fAllocCounts[last], double(sumCount) / frames,
+                            (unsigned long long)maxCount));
+    drawLine(SkStringPrintf("KB/frame: %.1f last, %.1f avg, %.1f max",
+                            fAllocBytes[last] / 1024.0, sumBytes / 1024.0 / frames,
+                            maxBytes / 1024.0));
+    drawLine(SkStringPrintf("Total: %llu allocs, %.1f MB",
+                            (unsigned long long)fLastAllocCount, fLastAllocBytes / kMB));
+}
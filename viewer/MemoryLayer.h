@@ -0,0 +1,50 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef MemoryLayer_DEFINED
+#define MemoryLayer_DEFINED
+
+#include "tools/sk_app/Window.h"
+
+#include <cstdint>
+
+class SkSurface;
+
+/**
+ *  Overlay with the process resident set size, the SkGraphics font and resource cache usage
+ *  against their limits, and the number and size of heap allocations made per frame.
+ *
+ *  Allocations are counted by replacing glibc's malloc family (malloc, calloc, realloc, the
+ *  aligned variants, and free, all forwarded to glibc; glibc only, and not under sanitizers,
+ *  which interpose them themselves). They cover every thread, so work that a slide hands to
+ *  SkTaskGroup is included. Memory mapped directly with mmap is not counted.
+ */
+class MemoryLayer : public sk_app::Window::Layer {
+public:
+    MemoryLayer();
+
+    static bool CountsAllocations();
+
+    void resetMeasurements();
+    void setDisplayScale(float scale) { fDisplayScale = scale; }
+
+    void onPrePaint() override;
+    void onPaint(SkSurface*) override;
+
+private:
+    static const int kMeasurementCount = 1 << 6;  // should be power of 2 for fast mod
+
+    uint64_t fAllocCounts[kMeasurementCount];
+    uint64_t fAllocBytes[kMeasurementCount];
+    uint64_t fLastAllocCount;
+    uint64_t fLastAllocBytes;
+    int fCurrentMeasurement;
+    int fMeasuredFrames;
+    float fDisplayScale;
+};
+
+#endif
@@ -4,13 +4,31 @@
  * Use of this source code is governed by a BSD-style license that can be
  * found in the LICENSE file.
  */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <utility>
 #include <vector>
 
+#include "include/core/SkBitmap.h"
 #include "include/core/SkCanvas.h"
+#include "include/core/SkColorPriv.h"
+#include "include/core/SkFont.h"
+#include "include/core/SkImage.h"
 #include "include/core/SkPath.h"
+#include "include/core/SkPixmap.h"
+#include "include/core/SkRRect.h"
+#include "include/core/SkSurface.h"
 #include "include/effects/SkGradientShader.h"
+#include "include/private/base/SkTPin.h"
+#include "include/private/base/SkTo.h"
 #include "src/base/SkRandom.h"
+#include "src/base/SkTime.h"
+#include "tools/DecodeUtils.h"
 #include "tools/Resources.h"
+#include "tools/flags/CommandLineFlags.h"
+#include "tools/fonts/FontToolUtils.h"
 #include "tools/gpu/YUVUtils.h"
 #include "tools/viewer/Slide.h"
 
@@ -19,7 +37,26 @@
 // * Canvas Lines
 // * Canvas Arcs
 // * Paths
+// * Bouncing Tagged Images
+// * Multiply
+// * Leaves
+// * Suits
+// * Design
+// * Images
 // Based on https://github.com/WebKit/MotionMark/blob/main/MotionMark/
+//
+// Each stage can be driven by hand ('+'/'-'), held at a fixed complexity ('F'), or ramped by
+// MotionMark's controller ('R') to find the object count that sustains 60 fps. The ramp reports
+// that count as the stage's score; the frame times it uses are measured in real time between
+// frames, so it also works in the viewer's headless --bench mode. There, with
+// --motionMarkController ramp, each slide keeps rendering after --benchFrames until the ramp is
+// done (a few 500 ms tiers plus five 2 s ramps) and the score is written to the bench JSON.
+
+static DEFINE_string(motionMarkController, "manual",
+                     "Initial controller for the MotionMark slides: manual, fixed or ramp.");
+static DEFINE_bool(motionMarkBatched, false,
+                   "Start MotionMark Canvas Lines in its structure-of-arrays, paint-batched form "
+                   "('b' toggles it).");
 
 class MMObject {
 public:
@@ -30,14 +67,164 @@ public:
     virtual void animate(double /*nanos*/) = 0;
 };
 
+// Fits frame time against complexity with two segments, as MotionMark's analysis does: a flat
+// one where the machine keeps up (the time is then set by vsync or fixed overhead), and a rising
+// line beyond it. Returns the complexity at which the rising line reaches targetMs, or -1 if the
+// samples never rise.
+static double estimate_complexity(std::vector<std::pair<double, double>> samples,
+                                  double targetMs) {
+    const int n = samples.size();
+    if (n < 3) {
+        return -1;
+    }
+    std::sort(samples.begin(), samples.end());
+
+    // Suffix sums for the line fit of [k, n), prefix sums for the constant fit of [0, k).
+    std::vector<double> sx(n + 1, 0), sy(n + 1, 0), sxx(n + 1, 0), sxy(n + 1, 0), syy(n + 1, 0);
+    for (int i = n - 1; i >= 0; --i) {
+        auto [x, y] = samples[i];
+        sx[i] = sx[i + 1] + x;
+        sy[i] = sy[i + 1] + y;
+        sxx[i] = sxx[i + 1] + x * x;
+        sxy[i] = sxy[i + 1] + x * y;
+        syy[i] = syy[i + 1] + y * y;
+    }
+    double bestError = -1, bestSlope = 0, bestIntercept = 0;
+    for (int k = 0; k <= n - 2; ++k) {
+        double leftY = sy[0] - sy[k], leftYY = syy[0] - syy[k];
+        double leftError = k > 0 ? leftYY - leftY * leftY / k : 0;
+
+        int m = n - k;
+        double cxx = sxx[k] - sx[k] * sx[k] / m;
+        double cxy = sxy[k] - sx[k] * sy[k] / m;
+        double cyy = syy[k] - sy[k] * sy[k] / m;
+        if (cxx <= 0) {
+            continue;
+        }
+        double error = leftError + cyy - cxy * cxy / cxx;
+        if (bestError < 0 || error < bestError) {
+            bestError = error;
+            bestSlope = cxy / cxx;
+            bestIntercept = (sy[k] - bestSlope * sx[k]) / m;
+        }
+    }
+    if (bestError < 0 || bestSlope <= 0) {
+        return -1;
+    }
+    return std::max(0.0, (targetMs - bestIntercept) / bestSlope);
+}
+
 class Stage {
 public:
+    // How the number of objects in the scene is chosen.
+    enum class Controller {
+        kManual,  // only by '+'/'-'
+        kFixed,   // held where it is; the score is the frame rate it sustains
+        kRamp,    // MotionMark's ramp; the score is the complexity that sustains the target rate
+    };
+
     Stage(SkSize size, int startingObjectCount, int objectIncrement)
             : fSize(size)
             , fStartingObjectCount(startingObjectCount)
             , fObjectIncrement(objectIncrement) {}
     virtual ~Stage() = default;
 
+    // Stages that do not keep their objects in fObjects override both of these.
+    virtual int complexity() const { return SkToInt(fObjects.size()); }
+
+    virtual void setComplexity(int count) {
+        count = std::max(1, count);
+        if (count < this->complexity()) {
+            fObjects.resize(count);
+        }
+        while (this->complexity() < count) {
+            fObjects.push_back(this->createObject());
+        }
+    }
+
+    Controller controller() const { return fController; }
+
+    // Whether the stage draws in batches rather than object by object ('b' on Canvas Lines).
+    virtual bool isBatched() const { return false; }
+
+    void setController(Controller controller) {
+        fController = controller;
+        fScore = 0;
+        fPhaseMs = 0;
+        fPhaseFrames = 0;
+        fSkipFrames = kSettleFrames;
+        fSamples.clear();
+        fEstimates.clear();
+        fRamping = false;
+        fDone = false;
+        if (controller == Controller::kRamp) {
+            // MotionMark starts from a single object and grows it tenfold per tier.
+            this->setComplexity(1);
+        }
+        fLastTickMs = 0;
+    }
+
+    // Whether the ramp has finished and score() is final.
+    bool isDone() const { return fController == Controller::kRamp && fDone; }
+    double score() const { return fScore; }
+
+    // Called once per frame, before animate(). Times the frame that has just been shown and lets
+    // the fixed and ramp controllers update the score and the object count.
+    void tick() {
+        double now = SkTime::GetMSecs();
+        double frameMs = fLastTickMs > 0 ? now - fLastTickMs : 0;
+        int drawnComplexity = fTickComplexity;
+
+        if (frameMs > 0 && fSkipFrames > 0) {
+            // The first frames after a change pay for object creation and cache warm-up.
+            --fSkipFrames;
+        } else if (frameMs > 0 && fController == Controller::kFixed) {
+            fPhaseMs += frameMs;
+            fPhaseFrames++;
+            fScore = 1000.0 * fPhaseFrames / fPhaseMs;
+        } else if (frameMs > 0 && fController == Controller::kRamp && !fDone) {
+            this->rampTick(drawnComplexity, frameMs);
+        }
+
+        fTickComplexity = this->complexity();
+        // Restart the clock so that creating objects above is not charged to the next frame.
+        fLastTickMs = SkTime::GetMSecs();
+    }
+
+    void drawControllerStatus(SkCanvas* canvas) const {
+        SkString status;
+        switch (fController) {
+            case Controller::kManual:
+                status.printf("%d objects  (R: ramp, F: fixed)", this->complexity());
+                break;
+            case Controller::kFixed:
+                status.printf("Fixed at %d objects: %.1f fps", this->complexity(), fScore);
+                break;
+            case Controller::kRamp:
+                if (fDone) {
+                    status.printf("Score: %.1f", fScore);
+                } else if (fRamping) {
+                    status.printf("Ramp %d/%d: %d objects in [%d, %d]",
+                                  SkToInt(fEstimates.size()) + 1, kRampCount, this->complexity(),
+                                  fRampMin, fRampMax);
+                } else {
+                    status.printf("Tier: %d objects", this->complexity());
+                }
+                break;
+        }
+        if (this->isBatched()) {
+            status.append("  [SoA, batched]");
+        }
+        SkFont font(ToolUtils::DefaultPortableTypeface(), 16);
+        SkRect bounds;
+        font.measureText(status.c_str(), status.size(), SkTextEncoding::kUTF8, &bounds);
+        SkPaint paint;
+        paint.setColor(0xC0FFFFFF);
+        canvas->drawRect(SkRect::MakeXYWH(4, 4, bounds.width() + 12, 24), paint);
+        paint.setColor(SK_ColorBLACK);
+        canvas->drawString(status, 10, 22, font, paint);
+    }
+
     // The default impls of draw() and animate() simply iterate over fObjects and call the
     // MMObject function.
     virtual void draw(SkCanvas* canvas) {
@@ -53,22 +240,32 @@ public:
         return true;
     }
 
-    // The default impl handles +/- to add or remove N objects from the scene
+    // The default impl handles +/- to add or remove N objects from the scene, and R/F to switch
+    // between the ramp, fixed and manual controllers. Adding or removing objects ends a ramp.
     virtual bool onChar(SkUnichar uni) {
         bool handled = false;
         switch (uni) {
             case '+':
             case '=':
-                for (int i = 0; i < fObjectIncrement; ++i) {
-                    fObjects.push_back(this->createObject());
-                }
+                this->setComplexity(this->complexity() + fObjectIncrement);
+                this->restartAfterManualChange();
                 handled = true;
                 break;
             case '-':
             case '_':
-                if (fObjects.size() > (size_t) fObjectIncrement) {
-                    fObjects.resize(fObjects.size() - (size_t) fObjectIncrement);
+                if (this->complexity() > fObjectIncrement) {
+                    this->setComplexity(this->complexity() - fObjectIncrement);
                 }
+                this->restartAfterManualChange();
+                handled = true;
+                break;
+            case 'R':
+                this->setController(Controller::kRamp);
+                handled = true;
+                break;
+            case 'F':
+                this->setController(fController == Controller::kFixed ? Controller::kManual
+                                                                      : Controller::kFixed);
                 handled = true;
                 break;
             default:
@@ -94,6 +291,102 @@ protected:
 
     std::vector<std::unique_ptr<MMObject>> fObjects;
     SkRandom fRandom;
+
+private:
+    static constexpr double kTargetFrameMs = 1000.0 / 60;
+    static constexpr double kTierMs = 500;
+    static constexpr double kRampMs = 2000;
+    static constexpr int kRampCount = 5;
+    static constexpr int kSettleFrames = 2;
+    static constexpr int kMaxComplexity = 1 << 20;
+
+    void restartAfterManualChange() {
+        if (fController == Controller::kRamp) {
+            this->setController(Controller::kManual);
+        } else if (fController == Controller::kFixed) {
+            this->setController(Controller::kFixed);
+        }
+    }
+
+    void startRamp(int minComplexity, int maxComplexity) {
+        fRampMin = std::max(1, minComplexity);
+        fRampMax = std::min(kMaxComplexity, std::max(fRampMin + 1, maxComplexity));
+        fRamping = true;
+        fPhaseMs = 0;
+        fSamples.clear();
+        this->setComplexity(fRampMax);
+        fSkipFrames = kSettleFrames;
+    }
+
+    void rampTick(int drawnComplexity, double frameMs) {
+        fPhaseMs += frameMs;
+        if (!fRamping) {
+            // Tier phase: grow tenfold while the mean frame time stays within the target.
+            fPhaseFrames++;
+            if (fPhaseMs < kTierMs || fPhaseFrames < 3) {
+                return;
+            }
+            double meanMs = fPhaseMs / fPhaseFrames;
+            int tier = this->complexity();
+            if (meanMs <= kTargetFrameMs * 1.05 && tier * 10 <= kMaxComplexity) {
+                fPhaseMs = 0;
+                fPhaseFrames = 0;
+                this->setComplexity(tier * 10);
+                fSkipFrames = kSettleFrames;
+            } else {
+                this->startRamp(tier / 10, tier);
+            }
+            return;
+        }
+
+        // Ramp phase: sweep from the maximum down to the minimum, then fit where frame time
+        // crosses the target and narrow the next ramp around it.
+        fSamples.push_back({static_cast<double>(drawnComplexity), frameMs});
+        double t = fPhaseMs / kRampMs;
+        if (t < 1) {
+            this->setComplexity(SkToInt(std::lround(fRampMax - (fRampMax - fRampMin) * t)));
+            return;
+        }
+        double estimate = estimate_complexity(fSamples, kTargetFrameMs);
+        if (estimate < 0 || estimate > fRampMax) {
+            // Every complexity in the ramp kept up; look higher next time.
+            fEstimates.push_back(fRampMax);
+            if (SkToInt(fEstimates.size()) < kRampCount) {
+                this->startRamp(fRampMax / 2, fRampMax * 2);
+            }
+        } else {
+            fEstimates.push_back(estimate);
+            if (SkToInt(fEstimates.size()) < kRampCount) {
+                this->startRamp(SkToInt(estimate * 0.5), SkToInt(estimate * 1.5) + 1);
+            }
+        }
+        if (SkToInt(fEstimates.size()) == kRampCount) {
+            std::vector<double> sorted = fEstimates;
+            std::sort(sorted.begin(), sorted.end());
+            fScore = sorted[sorted.size() / 2];
+            fDone = true;
+            fRamping = false;
+            this->setComplexity(SkToInt(std::lround(fScore)));
+        }
+    }
+
+    Controller fController = Controller::kManual;
+    double fScore = 0;
+    double fLastTickMs = 0;
+    int fTickComplexity = 0;
+    int fSkipFrames = 0;
+
+    // Fixed and tier phases: time and frames since the phase started.
+    double fPhaseMs = 0;
+    int fPhaseFrames = 0;
+
+    // Ramp phase.
+    bool fRamping = false;
+    bool fDone = false;
+    int fRampMin = 0;
+    int fRampMax = 0;
+    std::vector<std::pair<double, double>> fSamples;  // complexity, frame ms
+    std::vector<double> fEstimates;                   // one per finished ramp
 };
 
 class MotionMarkSlide : public Slide {
@@ -106,14 +399,54 @@ public:
 
     void draw(SkCanvas* canvas) override {
         fStage->draw(canvas);
+        fStage->drawControllerStatus(canvas);
     }
 
     bool animate(double nanos) override {
+        if (!fControllerStarted) {
+            // Done here rather than in load() so the subclasses' stages can be constructed first.
+            fControllerStarted = true;
+            const char* controller = FLAGS_motionMarkController.isEmpty()
+                                             ? "" : FLAGS_motionMarkController[0];
+            if (!strcmp(controller, "ramp")) {
+                fStage->setController(Stage::Controller::kRamp);
+            } else if (!strcmp(controller, "fixed")) {
+                fStage->setController(Stage::Controller::kFixed);
+            }
+        }
+        fStage->tick();
+        if (fStage->isDone() && !fScoreReported) {
+            SkDebugf("%s: MotionMark score %.1f\n", fName.c_str(), fStage->score());
+            fScoreReported = true;
+        } else if (!fStage->isDone()) {
+            fScoreReported = false;
+        }
         return fStage->animate(nanos);
     }
 
+    void unload() override {
+        fControllerStarted = false;
+        fScoreReported = false;
+    }
+
+    bool isScorePending() const override {
+        return fStage && fStage->controller() == Stage::Controller::kRamp && !fStage->isDone();
+    }
+
+    bool getScore(double* score) const override {
+        if (!fStage || !fStage->isDone()) {
+            return false;
+        }
+        *score = fStage->score();
+        return true;
+    }
+
 protected:
     std::unique_ptr<Stage> fStage;
+
+private:
+    bool fControllerStarted = false;
+    bool fScoreReported = false;
 };
 
 
@@ -208,6 +541,16 @@ public:
         fLength += std::sin(time_counter_value(nanos, 100) * fOmega);
     }
 
+    // For CanvasLineSegmentSoAStage, which uses this class only to generate segments.
+    SkColor color() const { return fColor; }
+    float lineWidth() const { return fLineWidth; }
+    float omega() const { return fOmega; }
+    SkPoint start() const { return fStart; }
+    SkVector direction() const {
+        return {fSegmentDirection * fCosTheta, fSegmentDirection * fSinTheta};
+    }
+    float length() const { return fLength; }
+
 private:
     SkColor fColor;
     float fLineWidth;
@@ -221,7 +564,7 @@ private:
 
 class CanvasLineSegmentStage : public Stage {
 public:
-    CanvasLineSegmentStage(SkSize size)
+    CanvasLineSegmentStage(SkSize size, bool createObjects = true)
             : Stage(size, /*startingObjectCount=*/5000, /*objectIncrement*/1000) {
         fParams.fLineMinimum = 20;
         fParams.fLineLengthMaximum = 40;
@@ -234,12 +577,30 @@ public:
         fHalfSize = SkSize::Make(fSize.fWidth * 0.5f, fSize.fHeight * 0.5f);
         fTwoFifthsSizeX = fSize.fWidth * .4;
 
-        this->initializeObjects();
+        if (createObjects) {
+            this->initializeObjects();
+        }
     }
 
     ~CanvasLineSegmentStage() override = default;
 
     void draw(SkCanvas* canvas) override {
+        this->drawBackground(canvas);
+        this->Stage::draw(canvas);
+    }
+
+    bool animate(double nanos) override {
+        this->animateBackground(nanos);
+        this->Stage::animate(nanos);
+        return true;
+    }
+
+    std::unique_ptr<MMObject> createObject() override {
+        return std::make_unique<CanvasLineSegment>(&fRandom,fParams);
+    }
+
+protected:
+    void drawBackground(SkCanvas* canvas) {
         canvas->clear(SK_ColorWHITE);
 
         float dx = fTwoFifthsSizeX * std::cos(fCurrentAngle);
@@ -299,30 +660,126 @@ public:
             canvas->drawArc(arcRect, 0, 360, false, paint);
             paint.setShader(nullptr);
         }
-
-        this->Stage::draw(canvas);
     }
 
-    bool animate(double nanos) override {
+    void animateBackground(double nanos) {
         fCurrentAngle = time_fractional_value(nanos, 3000) * SK_ScalarPI * 2;
         fCurrentGradientStep = 0.5f + 0.5f * std::sin(
                                        time_fractional_value(nanos, 5000) * SK_ScalarPI * 2);
-
-        this->Stage::animate(nanos);
-        return true;
     }
 
-    std::unique_ptr<MMObject> createObject() override {
-        return std::make_unique<CanvasLineSegment>(&fRandom,fParams);
-    }
-private:
     LineSegmentParams fParams;
+
+private:
     SkSize fHalfSize;
     float fTwoFifthsSizeX;
     float fCurrentAngle = 0;
     float fCurrentGradientStep = 0.5f;
 };
 
+// Canvas Lines with the segments in structure-of-arrays form instead of one heap-allocated
+// CanvasLineSegment each. Animation is a single loop over contiguous arrays, and drawing emits
+// one drawPoints(kLines_PointMode) per paint: segments are grouped by colour and by stroke width
+// rounded to whole pixels, so the stroke widths and the draw order differ slightly from the
+// per-object stage.
+class CanvasLineSegmentSoAStage : public CanvasLineSegmentStage {
+public:
+    CanvasLineSegmentSoAStage(SkSize size) : CanvasLineSegmentStage(size, /*createObjects=*/false) {
+        this->setComplexity(fStartingObjectCount);
+    }
+
+    bool isBatched() const override { return true; }
+
+    int complexity() const override { return SkToInt(fLength.size()); }
+
+    void setComplexity(int count) override {
+        count = std::max(1, count);
+        if (count < this->complexity()) {
+            for (auto* array : {&fStartX, &fStartY, &fDirX, &fDirY, &fLength, &fOmega}) {
+                array->resize(count);
+            }
+            fGroup.resize(count);
+        }
+        while (this->complexity() < count) {
+            // Generated exactly as the per-object stage does.
+            CanvasLineSegment segment(&fRandom, fParams);
+            fStartX.push_back(segment.start().fX);
+            fStartY.push_back(segment.start().fY);
+            fDirX.push_back(segment.direction().fX);
+            fDirY.push_back(segment.direction().fY);
+            fLength.push_back(segment.length());
+            fOmega.push_back(segment.omega());
+            fGroup.push_back(this->findGroup(segment.color(), segment.lineWidth()));
+        }
+    }
+
+    bool animate(double nanos) override {
+        this->animateBackground(nanos);
+
+        const float t = time_counter_value(nanos, 100);
+        const int n = this->complexity();
+        float* length = fLength.data();
+        const float* omega = fOmega.data();
+        for (int i = 0; i < n; ++i) {
+            length[i] += std::sin(t * omega[i]);
+        }
+        return true;
+    }
+
+    void draw(SkCanvas* canvas) override {
+        this->drawBackground(canvas);
+
+        for (Group& group : fGroups) {
+            group.fPoints.clear();
+        }
+        const int n = this->complexity();
+        for (int i = 0; i < n; ++i) {
+            std::vector<SkPoint>& points = fGroups[fGroup[i]].fPoints;
+            points.push_back({fStartX[i], fStartY[i]});
+            points.push_back({fStartX[i] + fDirX[i] * fLength[i],
+                              fStartY[i] + fDirY[i] * fLength[i]});
+        }
+
+        SkPaint paint;
+        paint.setAntiAlias(true);
+        paint.setStyle(SkPaint::kStroke_Style);
+        for (const Group& group : fGroups) {
+            if (group.fPoints.empty()) {
+                continue;
+            }
+            paint.setColor(group.fColor);
+            paint.setStrokeWidth(group.fWidth);
+            canvas->drawPoints(SkCanvas::kLines_PointMode, group.fPoints.size(),
+                               group.fPoints.data(), paint);
+        }
+    }
+
+private:
+    struct Group {
+        SkColor fColor;
+        float fWidth;
+        std::vector<SkPoint> fPoints;  // pairs of end points, rebuilt every frame
+    };
+
+    uint16_t findGroup(SkColor color, float width) {
+        width = std::round(width);
+        for (size_t i = 0; i < fGroups.size(); ++i) {
+            if (fGroups[i].fColor == color && fGroups[i].fWidth == width) {
+                return SkToU16(i);
+            }
+        }
+        fGroups.push_back({color, width, {}});
+        return SkToU16(fGroups.size() - 1);
+    }
+
+    std::vector<float> fStartX, fStartY;
+    std::vector<float> fDirX, fDirY;  // unit direction, including the segment's sign
+    std::vector<float> fLength;
+    std::vector<float> fOmega;
+    std::vector<uint16_t> fGroup;     // index into fGroups
+    std::vector<Group> fGroups;
+};
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // Canvas Arcs
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -869,6 +1326,553 @@ private:
     sk_sp<SkImage> fImages[kImageCount];
 };
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Multiply
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// A rounded square that spins in place. MotionMark's Multiply fills a grid outward from the
+// centre; hue, lightness and opacity follow the distance to the centre and pulse over time.
+class MultiplyTile : public MMObject {
+public:
+    MultiplyTile(SkRandom* random, SkPoint center, float size, float distance)
+            : fCenter(center)
+            , fSize(size)
+            , fDistance(distance)
+            , fRotationSpeed(random->nextRangeF(0.5f, 1.5f) * (random->nextBool() ? 1 : -1))
+            , fStartRotation(random->nextRangeF(0, 360)) {}
+
+    void animate(double nanos) override {
+        float seconds = static_cast<float>(nanos * 1e-9);
+        fRotation = SkScalarMod(fStartRotation + seconds * 90 * fRotationSpeed, 360.f);
+        float wave = std::sin(seconds * 2 - fDistance * 6);
+        fHue = SkScalarMod(fDistance * 360 + seconds * 20, 360.f);
+        fValue = 0.75f + 0.25f * wave;
+        fAlpha = SkTPin(1.2f - fDistance + 0.2f * wave, 0.2f, 1.0f);
+    }
+
+    void draw(SkCanvas* canvas) override {
+        float hsv[3] = {fHue, 0.8f, fValue};
+        SkPaint paint;
+        paint.setAntiAlias(true);
+        paint.setColor(SkHSVToColor(SkScalarRoundToInt(fAlpha * 255), hsv));
+
+        float half = fSize * 0.4f;
+        canvas->save();
+        canvas->translate(fCenter.fX, fCenter.fY);
+        canvas->rotate(fRotation);
+        canvas->drawRRect(SkRRect::MakeRectXY(SkRect::MakeLTRB(-half, -half, half, half),
+                                              half * 0.3f, half * 0.3f), paint);
+        canvas->restore();
+    }
+
+private:
+    SkPoint fCenter;
+    float fSize;
+    float fDistance;  // 0 at the centre of the stage, 1 at its corners
+    float fRotationSpeed;
+    float fStartRotation;
+    float fRotation = 0;
+    float fHue = 0;
+    float fValue = 1;
+    float fAlpha = 1;
+};
+
+class MultiplyStage : public Stage {
+public:
+    MultiplyStage(SkSize size)
+            : Stage(size, /*startingObjectCount=*/500, /*objectIncrement=*/100) {
+        // Grid cells ordered by distance from the centre, so complexity grows outward.
+        fTileSize = std::max(8.f, std::round(fSize.fHeight / 25));
+        int columns = std::max(1, SkScalarFloorToInt(fSize.fWidth / fTileSize));
+        int rows = std::max(1, SkScalarFloorToInt(fSize.fHeight / fTileSize));
+        SkPoint center = {fSize.fWidth / 2, fSize.fHeight / 2};
+        float maxDistance = center.length();
+        for (int y = 0; y < rows; ++y) {
+            for (int x = 0; x < columns; ++x) {
+                SkPoint cell = {(x + 0.5f) * fTileSize, (y + 0.5f) * fTileSize};
+                fCells.push_back({cell, SkPoint::Distance(cell, center) / maxDistance});
+            }
+        }
+        std::stable_sort(fCells.begin(), fCells.end(), [](const Cell& a, const Cell& b) {
+            return a.fDistance < b.fDistance;
+        });
+
+        this->initializeObjects();
+    }
+
+    void draw(SkCanvas* canvas) override {
+        canvas->clear(SK_ColorBLACK);
+        this->Stage::draw(canvas);
+    }
+
+    std::unique_ptr<MMObject> createObject() override {
+        // Past the last cell, the grid is filled again on top of itself.
+        const Cell& cell = fCells[fObjects.size() % fCells.size()];
+        return std::make_unique<MultiplyTile>(&fRandom, cell.fCenter, fTileSize, cell.fDistance);
+    }
+
+private:
+    struct Cell {
+        SkPoint fCenter;
+        float fDistance;
+    };
+    std::vector<Cell> fCells;
+    float fTileSize;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Leaves
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// A falling, spinning image that fades in at the top of the stage and out at the bottom.
+class Leaf : public MMObject {
+public:
+    Leaf(SkRandom* random, SkSize stageSize, int imageCount)
+            : fStageSize(stageSize)
+            , fImage(random->nextRangeU(0, imageCount - 1))
+            , fSize(random->nextRangeF(20, 80))
+            , fPosition({random->nextRangeF(0, stageSize.fWidth),
+                         random->nextRangeF(-fSize, stageSize.fHeight)})
+            , fFallSpeed(random->nextRangeF(30, 120))
+            , fSwayPhase(random_angle(random))
+            , fSwaySpeed(random->nextRangeF(0.5f, 2.f))
+            , fRotation(random->nextRangeF(0, 360))
+            , fRotationSpeed(random->nextRangeF(-90, 90)) {}
+
+    void animate(double deltaNanos) override {
+        float seconds = static_cast<float>(deltaNanos * 1e-9);
+        fSwayPhase += fSwaySpeed * seconds;
+        fPosition.fX += std::sin(fSwayPhase) * 30 * seconds;
+        fPosition.fY += fFallSpeed * seconds;
+        fRotation = SkScalarMod(fRotation + fRotationSpeed * seconds, 360.f);
+        if (fPosition.fY > fStageSize.fHeight + fSize) {
+            fPosition.fY = -fSize;
+        }
+    }
+
+    // handled by the Stage
+    void draw(SkCanvas*) override {}
+
+    int image() const { return fImage; }
+    SkRect rect() const { return SkRect::MakeXYWH(-fSize / 2, -fSize / 2, fSize, fSize); }
+    SkPoint position() const { return fPosition; }
+    float rotation() const { return fRotation; }
+    float opacity() const {
+        float t = SkTPin(fPosition.fY / fStageSize.fHeight, 0.f, 1.f);
+        return SkTPin(std::min(t, 1 - t) * 4, 0.f, 1.f);
+    }
+
+private:
+    SkSize fStageSize;
+    int fImage;
+    float fSize;
+    SkPoint fPosition;
+    float fFallSpeed;   // px per second
+    float fSwayPhase;
+    float fSwaySpeed;
+    float fRotation;    // degrees
+    float fRotationSpeed;
+};
+
+class LeavesStage : public Stage {
+public:
+    LeavesStage(SkSize size)
+            : Stage(size, /*startingObjectCount=*/300, /*objectIncrement=*/50) {
+        this->initializeObjects();
+    }
+
+    bool animate(double nanos) override {
+        if (fLastTime < 0) {
+            fLastTime = nanos;
+        }
+        for (size_t i = 0; i < fObjects.size(); ++i) {
+            fObjects[i]->animate(nanos - fLastTime);
+        }
+        fLastTime = nanos;
+        return true;
+    }
+
+    void draw(SkCanvas* canvas) override {
+        if (!fImages[0]) {
+            this->initImages();
+        }
+        canvas->clear(0xff1a2a10);
+
+        SkPaint paint;
+        SkSamplingOptions sampling(SkFilterMode::kLinear);
+        for (size_t i = 0; i < fObjects.size(); ++i) {
+            const Leaf* leaf = static_cast<const Leaf*>(fObjects[i].get());
+            paint.setAlphaf(leaf->opacity());
+            canvas->save();
+            canvas->translate(leaf->position().fX, leaf->position().fY);
+            canvas->rotate(leaf->rotation());
+            canvas->drawImageRect(fImages[leaf->image()], leaf->rect(), sampling, &paint);
+            canvas->restore();
+        }
+    }
+
+    std::unique_ptr<MMObject> createObject() override {
+        return std::make_unique<Leaf>(&fRandom, fSize, kImageCount);
+    }
+
+private:
+    static constexpr int kImageCount = 4;
+
+    // MotionMark uses leaf PNGs with transparency; draw equivalent ones once instead.
+    void initImages() {
+        static constexpr SkColor kColors[kImageCount] = {
+            0xff6a9a2a, 0xffc8a030, 0xffc05020, 0xff8a3018
+        };
+        constexpr int kImageSize = 64;
+        SkPath leaf;
+        leaf.moveTo(32, 2);
+        leaf.cubicTo(58, 16, 58, 46, 32, 62);
+        leaf.cubicTo(6, 46, 6, 16, 32, 2);
+        for (int i = 0; i < kImageCount; ++i) {
+            sk_sp<SkSurface> surface = SkSurfaces::Raster(
+                    SkImageInfo::MakeN32Premul(kImageSize, kImageSize));
+            SkCanvas* canvas = surface->getCanvas();
+            canvas->clear(SK_ColorTRANSPARENT);
+            SkPaint paint;
+            paint.setAntiAlias(true);
+            paint.setColor(kColors[i]);
+            canvas->drawPath(leaf, paint);
+            paint.setColor(SkColorSetA(SK_ColorBLACK, 0x60));
+            paint.setStyle(SkPaint::kStroke_Style);
+            paint.setStrokeWidth(2);
+            canvas->drawLine(32, 6, 32, 60, paint);
+            fImages[i] = surface->makeImageSnapshot();
+        }
+    }
+
+    sk_sp<SkImage> fImages[kImageCount];
+    double fLastTime = -1;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Suits
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The four card suits in a unit box centred on the origin, built from overlapping contours that
+// the default winding fill merges.
+static SkPath make_suit(int suit) {
+    SkPath path;
+    switch (suit) {
+        case 0:  // hearts
+            path.addCircle(-0.25f, -0.2f, 0.27f);
+            path.addCircle(0.25f, -0.2f, 0.27f);
+            path.moveTo(-0.5f, -0.1f);
+            path.lineTo(0.5f, -0.1f);
+            path.lineTo(0, 0.5f);
+            path.close();
+            break;
+        case 1:  // diamonds
+            path.moveTo(0, -0.5f);
+            path.lineTo(0.38f, 0);
+            path.lineTo(0, 0.5f);
+            path.lineTo(-0.38f, 0);
+            path.close();
+            break;
+        case 2:  // clubs
+            path.addCircle(0, -0.22f, 0.22f);
+            path.addCircle(-0.24f, 0.08f, 0.22f);
+            path.addCircle(0.24f, 0.08f, 0.22f);
+            path.moveTo(-0.06f, 0);
+            path.lineTo(0.06f, 0);
+            path.lineTo(0.16f, 0.5f);
+            path.lineTo(-0.16f, 0.5f);
+            path.close();
+            break;
+        default:  // spades
+            path.addCircle(-0.24f, 0.1f, 0.24f);
+            path.addCircle(0.24f, 0.1f, 0.24f);
+            path.moveTo(0, -0.5f);
+            path.lineTo(0.47f, 0.05f);
+            path.lineTo(-0.47f, 0.05f);
+            path.close();
+            path.moveTo(-0.06f, 0.2f);
+            path.lineTo(0.06f, 0.2f);
+            path.lineTo(0.16f, 0.5f);
+            path.lineTo(-0.16f, 0.5f);
+            path.close();
+            break;
+    }
+    return path;
+}
+
+// A bouncing, spinning suit: a gradient-filled rect clipped to the suit's shape.
+class SuitsParticle : public BouncingParticle {
+public:
+    SuitsParticle(SkRandom* random, SkSize stageSize, SkSize particleSize, float maxVelocity)
+            : BouncingParticle(random, stageSize, particleSize, maxVelocity)
+            , fSuit(random->nextRangeU(0, 3)) {
+        float hsv[3] = {random->nextRangeF(0, 360), 0.8f, 0.9f};
+        fColors[0] = SkHSVToColor(hsv);
+        hsv[0] = SkScalarMod(hsv[0] + 60, 360.f);
+        hsv[2] = 0.5f;
+        fColors[1] = SkHSVToColor(hsv);
+    }
+
+    // handled by the Stage
+    void draw(SkCanvas*) override {}
+
+    int suit() const { return fSuit; }
+    const SkColor* colors() const { return fColors; }
+    SkPoint center() const {
+        return {fPosition.fX + fSize.width() / 2, fPosition.fY + fSize.height() / 2};
+    }
+    float size() const { return fSize.width(); }
+    float rotation() { return fRotater.degrees(); }
+
+private:
+    int fSuit;
+    SkColor fColors[2];
+};
+
+class SuitsStage : public BouncingParticlesStage {
+public:
+    SuitsStage(SkSize size) : BouncingParticlesStage(size) {
+        fParticleSize = {80, 80};
+        for (int i = 0; i < 4; ++i) {
+            fSuits[i] = make_suit(i);
+        }
+        this->initializeObjects();
+    }
+
+    void draw(SkCanvas* canvas) override {
+        canvas->clear(SK_ColorWHITE);
+
+        const SkPoint gradientPoints[2] = {{-0.5f, -0.5f}, {0.5f, 0.5f}};
+        const SkRect unit = SkRect::MakeLTRB(-0.5f, -0.5f, 0.5f, 0.5f);
+        SkPaint paint;
+        for (size_t i = 0; i < fObjects.size(); ++i) {
+            SuitsParticle* particle = static_cast<SuitsParticle*>(fObjects[i].get());
+            paint.setShader(SkGradientShader::MakeLinear(gradientPoints, particle->colors(),
+                                                         nullptr, 2, SkTileMode::kClamp));
+            canvas->save();
+            canvas->translate(particle->center().fX, particle->center().fY);
+            canvas->rotate(particle->rotation());
+            canvas->scale(particle->size(), particle->size());
+            canvas->clipPath(fSuits[particle->suit()], /*doAntiAlias=*/true);
+            canvas->drawRect(unit, paint);
+            canvas->restore();
+        }
+    }
+
+    std::unique_ptr<MMObject> createObject() override {
+        return std::make_unique<SuitsParticle>(&fRandom, fSize, fParticleSize, fMaxVelocity);
+    }
+
+private:
+    SkPath fSuits[4];
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Design
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// A word that grows, turns and fades through a cycle, as in MotionMark's typographic Design
+// test. The font and the text width are set up once; each frame draws the string with
+// drawSimpleText, so the per-frame cost is the character to glyph mapping (no shaping), glyph
+// rasterization at the changing scale and the blits.
+class DesignText : public MMObject {
+public:
+    DesignText(SkRandom* random, SkSize stageSize) {
+        static constexpr const char* kWords[] = {
+            "MotionMark", "design", "typography", "kerning", "baseline", "serif", "glyph",
+            "leading", "tracking", "ligature", "ascender", "descender", "italic", "weight",
+            "Lorem ipsum", "dolor sit amet", "The quick brown fox", "jumps over the lazy dog",
+        };
+        fText = kWords[random->nextRangeU(0, std::size(kWords) - 1)];
+        fCenter = {random->nextRangeF(0, stageSize.fWidth),
+                   random->nextRangeF(0, stageSize.fHeight)};
+        fTextSize = 10 + std::pow(random->nextF(), 3) * 60;
+        fCycleSeconds = random->nextRangeF(2, 6);
+        fPhase = random->nextF();
+        fMaxRotation = random->nextRangeF(-45, 45);
+        float hsv[3] = {random->nextRangeF(0, 360), 0.7f, 0.6f};
+        fColor = SkHSVToColor(hsv);
+        fLength = strlen(fText);
+        fFont = SkFont(ToolUtils::DefaultPortableTypeface(), fTextSize);
+        fWidth = fFont.measureText(fText, fLength, SkTextEncoding::kUTF8);
+    }
+
+    void animate(double nanos) override {
+        float t = SkScalarFraction(static_cast<float>(nanos * 1e-9) / fCycleSeconds + fPhase);
+        // Ease in, hold, ease out.
+        float presence = std::sin(t * SK_ScalarPI);
+        fScale = 0.5f + 0.5f * presence;
+        fAlpha = presence;
+        fRotation = fMaxRotation * (1 - presence);
+    }
+
+    void draw(SkCanvas* canvas) override {
+        SkPaint paint;
+        paint.setAntiAlias(true);
+        paint.setColor(fColor);
+        paint.setAlphaf(fAlpha);
+
+        canvas->save();
+        canvas->translate(fCenter.fX, fCenter.fY);
+        canvas->rotate(fRotation);
+        canvas->scale(fScale, fScale);
+        canvas->drawSimpleText(fText, fLength, SkTextEncoding::kUTF8, -fWidth / 2, fTextSize / 3,
+                               fFont, paint);
+        canvas->restore();
+    }
+
+private:
+    const char* fText;
+    size_t fLength;
+    SkFont fFont;
+    float fWidth;
+    SkPoint fCenter;
+    float fTextSize;
+    float fCycleSeconds;
+    float fPhase;
+    float fMaxRotation;
+    SkColor fColor;
+    float fScale = 1;
+    float fAlpha = 1;
+    float fRotation = 0;
+};
+
+class DesignStage : public Stage {
+public:
+    DesignStage(SkSize size)
+            : Stage(size, /*startingObjectCount=*/200, /*objectIncrement=*/50) {
+        this->initializeObjects();
+    }
+
+    void draw(SkCanvas* canvas) override {
+        canvas->clear(0xfff4f0e8);
+        this->Stage::draw(canvas);
+    }
+
+    std::unique_ptr<MMObject> createObject() override {
+        return std::make_unique<DesignText>(&fRandom, fSize);
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Images
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// MotionMark's image data test: each tile copies a block of a source image, runs a per-pixel
+// effect over it on the CPU, and writes it straight into the canvas (getImageData and
+// putImageData), moving to a new spot now and then.
+class ImageDataTile : public MMObject {
+public:
+    static constexpr int kTileSize = 50;
+
+    ImageDataTile(SkRandom* random, SkISize stageSize, SkISize sourceSize) : fRandom(random) {
+        fColumns = std::max(1, stageSize.width() / kTileSize);
+        fRows = std::max(1, stageSize.height() / kTileSize);
+        fSourceColumns = std::max(1, sourceSize.width() / kTileSize);
+        fSourceRows = std::max(1, sourceSize.height() / kTileSize);
+        fTile.allocN32Pixels(kTileSize, kTileSize);
+        this->relocate();
+    }
+
+    void animate(double) override {
+        if (fRandom->nextF() < 0.02f) {
+            this->relocate();
+        }
+    }
+
+    // handled by the Stage
+    void draw(SkCanvas*) override {}
+
+    void render(SkCanvas* canvas, const SkPixmap& source) {
+        SkPixmap tile;
+        fTile.peekPixels(&tile);
+        for (int y = 0; y < kTileSize; ++y) {
+            const uint32_t* src = source.addr32(fSource.fX, fSource.fY + y);
+            uint32_t* dst = tile.writable_addr32(0, y);
+            for (int x = 0; x < kTileSize; ++x) {
+                dst[x] = apply_effect(fEffect, src[x]);
+            }
+        }
+        canvas->writePixels(tile, fDestination.fX, fDestination.fY);
+    }
+
+private:
+    enum Effect { kGrayscale, kInvert, kSepia, kEffectCount };
+
+    static uint32_t apply_effect(int effect, uint32_t pixel) {
+        unsigned r = SkGetPackedR32(pixel), g = SkGetPackedG32(pixel), b = SkGetPackedB32(pixel);
+        switch (effect) {
+            case kGrayscale: {
+                unsigned l = (r * 77 + g * 150 + b * 29) >> 8;
+                r = g = b = l;
+                break;
+            }
+            case kInvert:
+                r = 255 - r;
+                g = 255 - g;
+                b = 255 - b;
+                break;
+            default: {
+                unsigned l = (r * 77 + g * 150 + b * 29) >> 8;
+                r = std::min(255u, l + 40);
+                g = std::min(255u, l + 20);
+                b = l * 3 / 4;
+                break;
+            }
+        }
+        return SkPackARGB32(SkGetPackedA32(pixel), r, g, b);
+    }
+
+    void relocate() {
+        fSource = {SkToInt(fRandom->nextRangeU(0, fSourceColumns - 1)) * kTileSize,
+                   SkToInt(fRandom->nextRangeU(0, fSourceRows - 1)) * kTileSize};
+        fDestination = {SkToInt(fRandom->nextRangeU(0, fColumns - 1)) * kTileSize,
+                        SkToInt(fRandom->nextRangeU(0, fRows - 1)) * kTileSize};
+        fEffect = fRandom->nextRangeU(0, kEffectCount - 1);
+    }
+
+    SkRandom* fRandom;
+    int fColumns, fRows, fSourceColumns, fSourceRows;
+    SkIPoint fSource;
+    SkIPoint fDestination;
+    int fEffect;
+    SkBitmap fTile;
+};
+
+class ImageDataStage : public Stage {
+public:
+    ImageDataStage(SkSize size)
+            : Stage(size, /*startingObjectCount=*/50, /*objectIncrement=*/10) {
+        // The source is decoded once; a checkerboard stands in if the resource is missing.
+        sk_sp<SkImage> image = ToolUtils::GetResourceAsImage("images/mandrill_512_q075.jpg");
+        if (!image || !fSource.tryAllocN32Pixels(image->width(), image->height()) ||
+            !image->readPixels(nullptr, fSource.pixmap(), 0, 0)) {
+            fSource.allocN32Pixels(512, 512);
+            for (int y = 0; y < 512; ++y) {
+                for (int x = 0; x < 512; ++x) {
+                    *fSource.getAddr32(x, y) = ((x ^ y) & 32) ? SkPackARGB32(255, x / 2, y / 2, 128)
+                                                              : SkPackARGB32(255, 255, 255, 255);
+                }
+            }
+        }
+        this->initializeObjects();
+    }
+
+    void draw(SkCanvas* canvas) override {
+        canvas->clear(SK_ColorWHITE);
+        for (size_t i = 0; i < fObjects.size(); ++i) {
+            static_cast<ImageDataTile*>(fObjects[i].get())->render(canvas, fSource.pixmap());
+        }
+    }
+
+    std::unique_ptr<MMObject> createObject() override {
+        return std::make_unique<ImageDataTile>(&fRandom, fSize.toCeil(), fSource.dimensions());
+    }
+
+private:
+    SkBitmap fSource;
+};
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 class CanvasLinesSlide : public MotionMarkSlide {
@@ -876,8 +1880,39 @@ public:
     CanvasLinesSlide() {fName = "MotionMarkCanvasLines"; }
 
     void load(SkScalar w, SkScalar h) override {
-        fStage = std::make_unique<CanvasLineSegmentStage>(SkSize::Make(w, h));
+        fSize = SkSize::Make(w, h);
+        fStage = make_stage(fSize, FLAGS_motionMarkBatched);
+    }
+
+    bool onChar(SkUnichar uni) override {
+        if (uni != 'b') {
+            return this->MotionMarkSlide::onChar(uni);
+        }
+        if (fStage->controller() == Stage::Controller::kRamp && !fStage->isDone()) {
+            // The ramp's samples only describe the current stage; let it finish first.
+            SkDebugf("%s: finish or stop the ramp before switching stages\n", fName.c_str());
+            return true;
+        }
+        // Swap between the per-object and the batched stage at the same complexity. A fixed
+        // measurement restarts on the new stage; a finished ramp's score stays with the old one.
+        std::unique_ptr<Stage> stage = make_stage(fSize, !fStage->isBatched());
+        stage->setComplexity(fStage->complexity());
+        if (fStage->controller() == Stage::Controller::kFixed) {
+            stage->setController(Stage::Controller::kFixed);
+        }
+        fStage = std::move(stage);
+        return true;
     }
+
+private:
+    static std::unique_ptr<Stage> make_stage(SkSize size, bool batched) {
+        if (batched) {
+            return std::make_unique<CanvasLineSegmentSoAStage>(size);
+        }
+        return std::make_unique<CanvasLineSegmentStage>(size);
+    }
+
+    SkSize fSize;
 };
 
 class CanvasArcsSlide : public MotionMarkSlide {
@@ -913,7 +1948,57 @@ public:
     }
 };
 
+class MultiplySlide : public MotionMarkSlide {
+public:
+    MultiplySlide() {fName = "MotionMarkMultiply"; }
+
+    void load(SkScalar w, SkScalar h) override {
+        fStage = std::make_unique<MultiplyStage>(SkSize::Make(w, h));
+    }
+};
+
+class LeavesSlide : public MotionMarkSlide {
+public:
+    LeavesSlide() {fName = "MotionMarkLeaves"; }
+
+    void load(SkScalar w, SkScalar h) override {
+        fStage = std::make_unique<LeavesStage>(SkSize::Make(w, h));
+    }
+};
+
+class SuitsSlide : public MotionMarkSlide {
+public:
+    SuitsSlide() {fName = "MotionMarkSuits"; }
+
+    void load(SkScalar w, SkScalar h) override {
+        fStage = std::make_unique<SuitsStage>(SkSize::Make(w, h));
+    }
+};
+
+class DesignSlide : public MotionMarkSlide {
+public:
+    DesignSlide() {fName = "MotionMarkDesign"; }
+
+    void load(SkScalar w, SkScalar h) override {
+        fStage = std::make_unique<DesignStage>(SkSize::Make(w, h));
+    }
+};
+
+class ImagesSlide : public MotionMarkSlide {
+public:
+    ImagesSlide() {fName = "MotionMarkImages"; }
+
+    void load(SkScalar w, SkScalar h) override {
+        fStage = std::make_unique<ImageDataStage>(SkSize::Make(w, h));
+    }
+};
+
 DEF_SLIDE( return new CanvasLinesSlide(); )
 DEF_SLIDE( return new CanvasArcsSlide(); )
 DEF_SLIDE( return new PathsSlide(); )
 DEF_SLIDE( return new BouncingTaggedImagesSlide(); )
+DEF_SLIDE( return new MultiplySlide(); )
+DEF_SLIDE( return new LeavesSlide(); )
+DEF_SLIDE( return new SuitsSlide(); )
+DEF_SLIDE( return new DesignSlide(); )
+DEF_SLIDE( return new ImagesSlide(); )
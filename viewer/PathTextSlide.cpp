@@ -9,6 +9,8 @@
 #include "include/core/SkFont.h"
 #include "include/core/SkPaint.h"
 #include "include/core/SkPath.h"
+#include "include/private/base/SkTPin.h"
+#include "include/private/base/SkTo.h"
 #include "src/base/SkRandom.h"
 #include "src/base/SkVx.h"
 #include "src/core/SkPathPriv.h"
@@ -16,14 +18,21 @@
 #include "src/core/SkStrikeCache.h"
 #include "src/core/SkStrikeSpec.h"
 #include "src/core/SkTaskGroup.h"
+#include "tools/SkMetaData.h"
 #include "tools/ToolUtils.h"
+#include "tools/flags/CommandLineFlags.h"
 #include "tools/fonts/FontToolUtils.h"
 #include "tools/viewer/Slide.h"
 
+#include <vector>
+
+static DEFINE_int(pathTextGlyphs, 1500, "Initial number of glyphs in the PathText slide.");
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Static text from paths.
 class PathTextSlide : public Slide {
-    constexpr static int kNumPaths = 1500;
+    constexpr static int kNumGlyphPaths = 52;
+    constexpr static int kMaxGlyphs = 100000;
     SkSize fSize;
 
 public:
@@ -42,22 +51,20 @@ public:
         SkFont defaultFont = ToolUtils::DefaultFont();
         SkStrikeSpec strikeSpec = SkStrikeSpec::MakeWithNoDevice(defaultFont);
         SkBulkGlyphMetricsAndPaths pathMaker{strikeSpec};
-        SkPath glyphPaths[52];
-        for (int i = 0; i < 52; ++i) {
+        for (int i = 0; i < kNumGlyphPaths; ++i) {
             // I and l are rects on OS X ...
             char c = "aQCDEFGH7JKLMNOPBRZTUVWXYSAbcdefghijk1mnopqrstuvwxyz"[i];
             SkGlyphID id(defaultFont.unicharToGlyph(c));
             const SkGlyph* glyph = pathMaker.glyph(id);
             if (glyph->path()) {
-                glyphPaths[i] = *glyph->path();
+                fGlyphPaths[i] = *glyph->path();
             }
         }
 
-        for (int i = 0; i < kNumPaths; ++i) {
-            const SkPath& p = glyphPaths[i % 52];
-            fGlyphs[i].init(fRand, p);
-        }
-        this->reset();
+        int count = fGlyphs.empty() ? FLAGS_pathTextGlyphs : SkToInt(fGlyphs.size());
+        fGlyphAnimator.reset();
+        fGlyphs.clear();
+        this->setGlyphCount(count);
     }
 
     void resize(SkScalar w, SkScalar h) final {
@@ -67,6 +74,20 @@ public:
 
     bool onChar(SkUnichar) override;
 
+    bool onGetControls(SkMetaData* controls) override {
+        SkScalar glyphs[3] = {SkIntToScalar(fGlyphs.size()), 1, kMaxGlyphs};
+        controls->setScalars("Glyphs", 3, glyphs);
+        return true;
+    }
+
+    void onSetControls(const SkMetaData& controls) override {
+        SkScalar glyphs[3];
+        int count = 0;
+        if (controls.findScalars("Glyphs", &count, glyphs) && count == 3) {
+            this->setGlyphCount(SkScalarRoundToInt(glyphs[0]));
+        }
+    }
+
     bool animate(double nanos) final {
         return fGlyphAnimator->animate(nanos, fSize.width(), fSize.height());
     }
@@ -99,11 +120,11 @@ protected:
 
     class GlyphAnimator {
     public:
-        GlyphAnimator(Glyph* glyphs) : fGlyphs(glyphs) {}
+        GlyphAnimator(Glyph* glyphs, int count) : fGlyphs(glyphs), fCount(count) {}
         virtual void reset(SkRandom*, int screenWidth, int screenHeight) {}
         virtual bool animate(double nanos, int screenWidth, int screenHeight) { return false; }
         virtual void draw(SkCanvas* canvas) {
-            for (int i = 0; i < kNumPaths; ++i) {
+            for (int i = 0; i < fCount; ++i) {
                 Glyph& glyph = fGlyphs[i];
                 SkAutoCanvasRestore acr(canvas, true);
                 canvas->translate(glyph.fPosition.x(), glyph.fPosition.y());
@@ -117,16 +138,22 @@ protected:
 
     protected:
         Glyph* const fGlyphs;
+        const int fCount;
     };
 
     class MovingGlyphAnimator;
     class WavyGlyphAnimator;
 
-    Glyph fGlyphs[kNumPaths];
+    std::unique_ptr<GlyphAnimator> makeGlyphAnimator(SkUnichar kind);
+    void setGlyphCount(int count);
+
+    SkPath fGlyphPaths[kNumGlyphPaths];
+    std::vector<Glyph> fGlyphs;
     SkRandom fRand{25};
     SkPath fClipPath = ToolUtils::make_star(SkRect{0, 0, 1, 1}, 11, 3);
     bool fDoClip = false;
-    std::unique_ptr<GlyphAnimator> fGlyphAnimator = std::make_unique<GlyphAnimator>(fGlyphs);
+    SkUnichar fGlyphAnimatorKind = 'S';
+    std::unique_ptr<GlyphAnimator> fGlyphAnimator;
 };
 
 void PathTextSlide::Glyph::init(SkRandom& rand, const SkPath& path) {
@@ -152,10 +179,11 @@ void PathTextSlide::Glyph::reset(SkRandom& rand, int w, int h) {
 // Text from paths with animated transformation matrices.
 class PathTextSlide::MovingGlyphAnimator : public PathTextSlide::GlyphAnimator {
 public:
-    MovingGlyphAnimator(Glyph* glyphs)
-            : GlyphAnimator(glyphs)
-            , fFrontMatrices(new SkMatrix[kNumPaths])
-            , fBackMatrices(new SkMatrix[kNumPaths]) {
+    MovingGlyphAnimator(Glyph* glyphs, int count)
+            : GlyphAnimator(glyphs, count)
+            , fVelocities(new Velocity[count])
+            , fFrontMatrices(new SkMatrix[count])
+            , fBackMatrices(new SkMatrix[count]) {
     }
 
     ~MovingGlyphAnimator() override {
@@ -165,7 +193,8 @@ public:
     void reset(SkRandom* rand, int screenWidth, int screenHeight) override {
         const SkScalar screensize = static_cast<SkScalar>(std::max(screenWidth, screenHeight));
 
-        for (auto& v : fVelocities) {
+        for (int i = 0; i < fCount; ++i) {
+            Velocity& v = fVelocities[i];
             for (SkScalar* d : {&v.fDx, &v.fDy}) {
                 SkScalar t = pow(rand->nextF(), 3);
                 *d = ((1 - t) / 60 + t / 10) * (rand->nextBool() ? screensize : -screensize);
@@ -177,8 +206,8 @@ public:
 
         // Get valid front data.
         fBackgroundAnimationTask.wait();
-        this->runAnimationTask(0, 0, screenWidth, screenHeight);
-        std::copy_n(fBackMatrices.get(), kNumPaths, fFrontMatrices.get());
+        this->runAnimationTask(0, 0, screenWidth, screenHeight, 0, fCount);
+        std::copy_n(fBackMatrices.get(), fCount, fFrontMatrices.get());
         fLastTick = 0;
     }
 
@@ -188,17 +217,26 @@ public:
 
         const double tsec = 1e-9 * nanos;
         const double dt = fLastTick ? (1e-9 * nanos - fLastTick) : 0;
-        fBackgroundAnimationTask.add(std::bind(&MovingGlyphAnimator::runAnimationTask, this, tsec,
-                                               dt, screenWidth, screenHeight));
+        // Glyphs are independent, so the back buffers are filled in chunks spread over the
+        // thread pool (--threads). Chunks are much smaller than count / threads so that idle
+        // threads pick up the remaining ones from the pool's queue.
+        const int chunkCount = (fCount + kChunkSize - 1) / kChunkSize;
+        auto runChunk = [this, tsec, dt, screenWidth, screenHeight](int chunk) {
+            const int begin = chunk * kChunkSize;
+            this->runAnimationTask(tsec, dt, screenWidth, screenHeight, begin,
+                                   std::min(begin + kChunkSize, fCount));
+        };
+        fBackgroundAnimationTask.batch(chunkCount, runChunk);
         fLastTick = 1e-9 * nanos;
         return true;
     }
 
     /**
-     * Called on a background thread. Here we can only modify fBackMatrices.
+     * Called on a background thread for glyphs [begin, end). Here we can only modify
+     * fBackMatrices, and the glyphs and velocities in that range.
      */
-    virtual void runAnimationTask(double t, double dt, int w, int h) {
-        for (int idx = 0; idx < kNumPaths; ++idx) {
+    virtual void runAnimationTask(double t, double dt, int w, int h, int begin, int end) {
+        for (int idx = begin; idx < end; ++idx) {
             Velocity* v = &fVelocities[idx];
             Glyph* glyph = &fGlyphs[idx];
             SkMatrix* backMatrix = &fBackMatrices[idx];
@@ -235,7 +273,7 @@ public:
     }
 
     void draw(SkCanvas* canvas) override {
-        for (int i = 0; i < kNumPaths; ++i) {
+        for (int i = 0; i < fCount; ++i) {
             SkAutoCanvasRestore acr(canvas, true);
             canvas->concat(fFrontMatrices[i]);
             canvas->drawPath(fGlyphs[i].fPath, fGlyphs[i].fPaint);
@@ -243,12 +281,14 @@ public:
     }
 
 protected:
+    constexpr static int kChunkSize = 64;
+
     struct Velocity {
         SkScalar fDx, fDy;
         SkScalar fDSpin;
     };
 
-    Velocity fVelocities[kNumPaths];
+    std::unique_ptr<Velocity[]> fVelocities;
     std::unique_ptr<SkMatrix[]> fFrontMatrices;
     std::unique_ptr<SkMatrix[]> fBackMatrices;
     SkTaskGroup fBackgroundAnimationTask;
@@ -260,10 +300,10 @@ protected:
 // Text from paths with animated control points.
 class PathTextSlide::WavyGlyphAnimator : public PathTextSlide::MovingGlyphAnimator {
 public:
-    WavyGlyphAnimator(Glyph* glyphs)
-            : MovingGlyphAnimator(glyphs)
-            , fFrontPaths(new SkPath[kNumPaths])
-            , fBackPaths(new SkPath[kNumPaths]) {
+    WavyGlyphAnimator(Glyph* glyphs, int count)
+            : MovingGlyphAnimator(glyphs, count)
+            , fFrontPaths(new SkPath[count])
+            , fBackPaths(new SkPath[count]) {
     }
 
     ~WavyGlyphAnimator() override {
@@ -273,17 +313,19 @@ public:
     void reset(SkRandom* rand, int screenWidth, int screenHeight) override {
         fWaves.reset(*rand, screenWidth, screenHeight);
         this->MovingGlyphAnimator::reset(rand, screenWidth, screenHeight);
-        std::copy(fBackPaths.get(), fBackPaths.get() + kNumPaths, fFrontPaths.get());
+        std::copy(fBackPaths.get(), fBackPaths.get() + fCount, fFrontPaths.get());
     }
 
     /**
-     * Called on a background thread. Here we can only modify fBackPaths.
+     * Called on a background thread for glyphs [begin, end). Here we can only modify fBackPaths
+     * in that range.
      */
-    void runAnimationTask(double t, double dt, int width, int height) override {
+    void runAnimationTask(double t, double dt, int width, int height, int begin,
+                          int end) override {
         const float tsec = static_cast<float>(t);
-        this->MovingGlyphAnimator::runAnimationTask(t, 0.5 * dt, width, height);
+        this->MovingGlyphAnimator::runAnimationTask(t, 0.5 * dt, width, height, begin, end);
 
-        for (int i = 0; i < kNumPaths; ++i) {
+        for (int i = begin; i < end; ++i) {
             const Glyph& glyph = fGlyphs[i];
             const SkMatrix& backMatrix = fBackMatrices[i];
 
@@ -334,7 +376,7 @@ public:
     }
 
     void draw(SkCanvas* canvas) override {
-        for (int i = 0; i < kNumPaths; ++i) {
+        for (int i = 0; i < fCount; ++i) {
             canvas->drawPath(fFrontPaths[i], fGlyphs[i].fPaint);
         }
     }
@@ -432,23 +474,56 @@ SkPoint PathTextSlide::WavyGlyphAnimator::Waves::apply(float tsec, const skvx::f
     return {devicePt[0] + offsetY[0] + offsetY[1], devicePt[1] - offsetX[0] - offsetX[1]};
 }
 
+std::unique_ptr<PathTextSlide::GlyphAnimator> PathTextSlide::makeGlyphAnimator(SkUnichar kind) {
+    Glyph* glyphs = fGlyphs.data();
+    int count = SkToInt(fGlyphs.size());
+    switch (kind) {
+        case 'M':
+            return std::make_unique<MovingGlyphAnimator>(glyphs, count);
+        case 'W':
+            return std::make_unique<WavyGlyphAnimator>(glyphs, count);
+        default:
+            return std::make_unique<GlyphAnimator>(glyphs, count);
+    }
+}
+
+void PathTextSlide::setGlyphCount(int count) {
+    count = SkTPin(count, 1, kMaxGlyphs);
+    if (fGlyphAnimator && count == SkToInt(fGlyphs.size())) {
+        return;
+    }
+    // Destroying the animator waits for its tasks, which point into fGlyphs.
+    fGlyphAnimator.reset();
+    const int oldCount = SkToInt(fGlyphs.size());
+    fGlyphs.resize(count);
+    for (int i = oldCount; i < count; ++i) {
+        fGlyphs[i].init(fRand, fGlyphPaths[i % kNumGlyphPaths]);
+    }
+    fGlyphAnimator = this->makeGlyphAnimator(fGlyphAnimatorKind);
+    this->reset();
+}
+
 bool PathTextSlide::onChar(SkUnichar unichar) {
     switch (unichar) {
         case 'X':
             fDoClip = !fDoClip;
             return true;
         case 'S':
-            fGlyphAnimator = std::make_unique<GlyphAnimator>(fGlyphs);
-            fGlyphAnimator->reset(&fRand, fSize.width(), fSize.height());
-            return true;
         case 'M':
-            fGlyphAnimator = std::make_unique<MovingGlyphAnimator>(fGlyphs);
-            fGlyphAnimator->reset(&fRand, fSize.width(), fSize.height());
-            return true;
         case 'W':
-            fGlyphAnimator = std::make_unique<WavyGlyphAnimator>(fGlyphs);
+            fGlyphAnimator.reset();
+            fGlyphAnimatorKind = unichar;
+            fGlyphAnimator = this->makeGlyphAnimator(fGlyphAnimatorKind);
             fGlyphAnimator->reset(&fRand, fSize.width(), fSize.height());
             return true;
+        case '+':
+        case '=':
+            this->setGlyphCount(SkToInt(fGlyphs.size()) * 2);
+            return true;
+        case '-':
+        case '_':
+            this->setGlyphCount(SkToInt(fGlyphs.size()) / 2);
+            return true;
     }
     return false;
 }
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "tools/viewer/PerfCounters.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+
+PerfCounters::PerfCounters() : fGroupFd(-1), fOpenCount(0) {
+    for (int i = 0; i < kCounterCount; ++i) {
+        fFds[i] = -1;
+        fIndex[i] = -1;
+    }
+}
+
+PerfCounters::~PerfCounters() { this->close(); }
+
+const char* PerfCounters::Name(Counter c) {
+    switch (c) {
+        case kCycles:       return "cycles";
+        case kInstructions: return "instructions";
+        case kCacheMisses:  return "llc_misses";
+        case kBranchMisses: return "branch_misses";
+        case kCounterCount: break;
+    }
+    return "";
+}
+
+#if defined(__linux__)
+
+bool PerfCounters::open() {
+    if (this->isOpen()) {
+        return true;
+    }
+    static const uint64_t kConfigs[kCounterCount] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    for (int i = 0; i < kCounterCount; ++i) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = kConfigs[i];
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // The whole group is enabled at once below.
+        attr.disabled = fGroupFd < 0 ? 1 : 0;
+        // User space only, so that the default perf_event_paranoid setting of 2 allows it.
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, /*pid=*/0, /*cpu=*/-1,
+                                          fGroupFd, /*flags=*/0));
+        if (fd < 0) {
+            continue;
+        }
+        if (fGroupFd < 0) {
+            fGroupFd = fd;
+        }
+        fFds[i] = fd;
+        fIndex[i] = fOpenCount++;
+    }
+    if (fGroupFd < 0) {
+        return false;
+    }
+    ioctl(fGroupFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fGroupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+void PerfCounters::close() {
+    for (int i = 0; i < kCounterCount; ++i) {
+        if (fFds[i] >= 0) {
+            ::close(fFds[i]);
+        }
+        fFds[i] = -1;
+        fIndex[i] = -1;
+    }
+    fGroupFd = -1;
+    fOpenCount = 0;
+}
+
+bool PerfCounters::read(Sample* sample) const {
+    if (fGroupFd < 0) {
+        return false;
+    }
+    // The number of counters, the enabled and running times, then the values in opening order.
+    uint64_t buffer[3 + kCounterCount];
+    ssize_t size = ::read(fGroupFd, buffer, sizeof(buffer));
+    if (size < static_cast<ssize_t>(3 * sizeof(uint64_t)) ||
+        buffer[0] != static_cast<uint64_t>(fOpenCount) ||
+        size < static_cast<ssize_t>((3 + fOpenCount) * sizeof(uint64_t))) {
+        return false;
+    }
+    sample->fTimeEnabled = buffer[1];
+    sample->fTimeRunning = buffer[2];
+    for (int i = 0; i < kCounterCount; ++i) {
+        sample->fCounts[i] = fIndex[i] >= 0 ? buffer[3 + fIndex[i]] : 0;
+    }
+    return true;
+}
+
+#else
+
+bool PerfCounters::open() { return false; }
+void PerfCounters::close() {}
+bool PerfCounters::read(Sample*) const { return false; }
+
+#endif
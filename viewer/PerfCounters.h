@@ -0,0 +1,97 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef PerfCounters_DEFINED
+#define PerfCounters_DEFINED
+
+#include <cstdint>
+
+/**
+ *  Hardware performance counters for the calling thread, read through perf_event_open on Linux.
+ *
+ *  Counters that the kernel, the CPU or a container's seccomp policy refuse are simply left out;
+ *  has() reports which ones are live. On other platforms open() always fails.
+ */
+class PerfCounters {
+public:
+    enum Counter {
+        kCycles,
+        kInstructions,
+        kCacheMisses,   // last level cache, on most CPUs
+        kBranchMisses,
+        kCounterCount,
+    };
+
+    struct Sample {
+        uint64_t fCounts[kCounterCount] = {};
+        // Nanoseconds the group was enabled and actually counting. They differ when the kernel
+        // multiplexes the PMU between more events than it has counters.
+        uint64_t fTimeEnabled = 0;
+        uint64_t fTimeRunning = 0;
+
+        Sample& operator+=(const Sample& that) {
+            for (int i = 0; i < kCounterCount; ++i) {
+                fCounts[i] += that.fCounts[i];
+            }
+            fTimeEnabled += that.fTimeEnabled;
+            fTimeRunning += that.fTimeRunning;
+            return *this;
+        }
+        Sample operator-(const Sample& that) const {
+            Sample result;
+            for (int i = 0; i < kCounterCount; ++i) {
+                result.fCounts[i] = fCounts[i] - that.fCounts[i];
+            }
+            result.fTimeEnabled = fTimeEnabled - that.fTimeEnabled;
+            result.fTimeRunning = fTimeRunning - that.fTimeRunning;
+            return result;
+        }
+
+        bool multiplexed() const { return fTimeRunning < fTimeEnabled; }
+
+        // Extrapolates the counts to the whole enabled time, as perf stat does. Returns false,
+        // leaving the sample alone, if the group never ran; the counts then mean nothing.
+        bool scale() {
+            if (fTimeRunning == 0) {
+                return false;
+            }
+            if (this->multiplexed()) {
+                double factor = static_cast<double>(fTimeEnabled) / fTimeRunning;
+                for (uint64_t& count : fCounts) {
+                    count = static_cast<uint64_t>(count * factor);
+                }
+                fTimeRunning = fTimeEnabled;
+            }
+            return true;
+        }
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Starts counting on the calling thread; returns false if no counter could be opened.
+    bool open();
+    void close();
+    bool isOpen() const { return fGroupFd >= 0; }
+    bool has(Counter c) const { return fIndex[c] >= 0; }
+
+    // Reads the raw counts accumulated since open(), with the group's enabled and running times.
+    // Unavailable counters read as zero. Differences between two reads should be scale()d.
+    bool read(Sample*) const;
+
+    static const char* Name(Counter);
+
+private:
+    int fGroupFd;
+    int fFds[kCounterCount];
+    int fIndex[kCounterCount];  // position in the group read, or -1
+    int fOpenCount;
+};
+
+#endif
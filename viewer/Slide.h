@@ -48,6 +48,14 @@ public:
     virtual bool onGetControls(SkMetaData*) { return false; }
     virtual void onSetControls(const SkMetaData&) {}
 
+    /**
+     * Slides that measure a score of their own (e.g. the MotionMark ramp) report it here, so that
+     * --bench can record it. isScorePending() is true while a score is being measured and the
+     * slide needs more frames; getScore() returns false until a score is available.
+     */
+    virtual bool isScorePending() const { return false; }
+    virtual bool getScore(double* score) const { return false; }
+
     const SkString& getName() { return fName; }
 
 protected:
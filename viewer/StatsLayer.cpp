@@ -15,41 +15,226 @@
 #include "include/core/SkRefCnt.h"
 #include "include/core/SkScalar.h"
 #include "include/core/SkSize.h"
+#include "include/core/SkStream.h"
 #include "include/core/SkString.h"
 #include "include/core/SkSurface.h"
 #include "include/core/SkTypeface.h"
 #include "include/private/base/SkAssert.h"
 #include "include/private/base/SkTDArray.h"
+#include "src/base/SkMathPriv.h"
 #include "src/base/SkTime.h"
+#include "src/utils/SkJSONWriter.h"
 #include "tools/fonts/FontToolUtils.h"
+#include "tools/viewer/PerfCounters.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <string>
 
+void StatsLayer::Histogram::reset() {
+    std::fill_n(fBuckets, kBucketCount, 0);
+    fCount = 0;
+    fMaxMS = 0;
+}
+
+void StatsLayer::Histogram::record(double ms) {
+    if (!(ms >= 0)) {
+        return;
+    }
+    uint32_t us = static_cast<uint32_t>(std::min(ms * 1000.0 + 0.5, double(INT32_MAX)));
+    int index = us;
+    if (us >= 2 * kSubBuckets) {
+        // Shift so that the top five bits remain: the leading one selects the power of two
+        // (together with the shift), the next four select the sub-bucket.
+        int shift = SkPrevLog2(us) - 4;
+        index = kSubBuckets * shift + (us >> shift);
+    }
+    SkASSERT(index >= 0 && index < kBucketCount);
+    fBuckets[index]++;
+    fCount++;
+    fMaxMS = std::max(fMaxMS, ms);
+}
+
+double StatsLayer::Histogram::quantileMS(double q) const {
+    if (fCount == 0) {
+        return 0;
+    }
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(q * fCount + 0.5));
+    uint64_t seen = 0;
+    for (int index = 0; index < kBucketCount; ++index) {
+        seen += fBuckets[index];
+        if (seen >= target) {
+            uint64_t upper = index + 1;
+            if (index >= 2 * kSubBuckets) {
+                int shift = index / kSubBuckets - 1;
+                upper = static_cast<uint64_t>(index - kSubBuckets * shift + 1) << shift;
+            }
+            return std::min(fMaxMS, upper / 1000.0);
+        }
+    }
+    return fMaxMS;
+}
+
+struct StatsLayer::Export {
+    enum Track { kCpuTrack, kFrameTrack, kGpuTrack };
+
+    explicit Export(const char* path) : fStream(path) {}
+
+    bool init(bool csv) {
+        if (!fStream.isValid()) {
+            return false;
+        }
+        fStartMS = SkTime::GetMSecs();
+        if (csv) {
+            fStream.writeText("frame,slide,timer,start_ms,duration_ms");
+            for (int c = 0; c < PerfCounters::kCounterCount; ++c) {
+                fStream.writeText(",");
+                fStream.writeText(PerfCounters::Name(static_cast<PerfCounters::Counter>(c)));
+            }
+            fStream.writeText("\n");
+            return true;
+        }
+        fJSON = std::make_unique<SkJSONWriter>(&fStream, SkJSONWriter::Mode::kFast);
+        fJSON->beginArray();
+        const char* trackNames[] = {"CPU", "Frame", "GPU"};
+        for (int track = 0; track < 3; ++track) {
+            fJSON->beginObject();
+            fJSON->appendCString("name", "thread_name");
+            fJSON->appendCString("ph", "M");
+            fJSON->appendS32("pid", 0);
+            fJSON->appendS32("tid", track);
+            fJSON->beginObject("args");
+            fJSON->appendCString("name", trackNames[track]);
+            fJSON->endObject();
+            fJSON->endObject();
+        }
+        return true;
+    }
+
+    ~Export() {
+        if (fJSON) {
+            fJSON->endArray();
+            fJSON->flush();
+        }
+        fStream.flush();
+    }
+
+    // counters and counts are only given for CPU timers while hardware counters are enabled.
+    void sample(Track track, const char* timer, const SkString& slide, int frame,
+                double beginMS, double durationMS, const PerfCounters* counters = nullptr,
+                const PerfCounters::Sample* counts = nullptr) {
+        double startMS = beginMS - fStartMS;
+        auto hasCounter = [&](int c) {
+            return counters && counts && counters->has(static_cast<PerfCounters::Counter>(c));
+        };
+        if (!fJSON) {
+            SkString quoted(slide);
+            for (size_t i = quoted.size(); i-- > 0;) {
+                if (quoted[i] == '"') {
+                    quoted.insert(i, "\"");
+                }
+            }
+            fStream.writeText(SkStringPrintf("%d,\"%s\",%s,%.4f,%.4f", frame, quoted.c_str(),
+                                             timer, startMS, durationMS).c_str());
+            for (int c = 0; c < PerfCounters::kCounterCount; ++c) {
+                fStream.writeText(",");
+                if (hasCounter(c)) {
+                    fStream.writeBigDecAsText(static_cast<int64_t>(counts->fCounts[c]));
+                }
+            }
+            fStream.writeText("\n");
+            return;
+        }
+        fJSON->beginObject();
+        fJSON->appendCString("name", timer);
+        fJSON->appendCString("cat", "viewer");
+        fJSON->appendCString("ph", "X");
+        fJSON->appendS32("pid", 0);
+        fJSON->appendS32("tid", track);
+        fJSON->appendDouble("ts", startMS * 1000);
+        fJSON->appendDouble("dur", durationMS * 1000);
+        fJSON->beginObject("args");
+        fJSON->appendS32("frame", frame);
+        fJSON->appendString("slide", slide);
+        for (int c = 0; c < PerfCounters::kCounterCount; ++c) {
+            if (hasCounter(c)) {
+                fJSON->appendU64(PerfCounters::Name(static_cast<PerfCounters::Counter>(c)),
+                                 counts->fCounts[c]);
+            }
+        }
+        fJSON->endObject();
+        fJSON->endObject();
+    }
+
+    SkFILEWStream fStream;
+    std::unique_ptr<SkJSONWriter> fJSON;  // null when writing CSV
+    double fStartMS = 0;
+};
+
 StatsLayer::StatsLayer()
-    : fCurrentMeasurement(-1)
+    : fJankCount(0)
+    , fFrameBudgetMS(1000.0 / 60.0)
+    , fFrame(0)
+    , fHistoryLength(kDefaultHistoryLength)
+    , fCurrentMeasurement(-1)
     , fLastTotalBegin(0)
     , fCumulativeMeasurementTime(0)
     , fCumulativeMeasurementCount(0)
     , fDisplayScale(1.0f) {
-    memset(fTotalTimes, 0, sizeof(fTotalTimes));
+    fTotalTimes.assign(fHistoryLength, 0);
+    fGpuTimer.fTimes.assign(fHistoryLength, 0);
 }
 
+StatsLayer::~StatsLayer() = default;
+
+bool StatsLayer::startExport(const char* path) {
+    this->stopExport();
+    auto exporter = std::make_unique<Export>(path);
+    if (!exporter->init(SkStrEndsWith(path, ".csv"))) {
+        return false;
+    }
+    fExport = std::move(exporter);
+    return true;
+}
+
+void StatsLayer::stopExport() { fExport.reset(); }
+
+bool StatsLayer::enablePerfCounters() {
+    // Counters follow the thread that opened them, which must be the one calling beginTiming.
+    return fPerfCounters.open();
+}
+
+void StatsLayer::disablePerfCounters() { fPerfCounters.close(); }
+
 void StatsLayer::resetMeasurements() {
     for (int i = 0; i < fTimers.size(); ++i) {
-        memset(fTimers[i].fTimes, 0, sizeof(fTimers[i].fTimes));
+        fTimers[i].fTimes.assign(fHistoryLength, 0);
+        fTimers[i].fCounts.assign(fHistoryLength, {});
+        fTimers[i].fHistogram.reset();
     }
-    memset(fTotalTimes, 0, sizeof(fTotalTimes));
+    fTotalTimes.assign(fHistoryLength, 0);
+    fTotalHistogram.reset();
+    fGpuTimer.fHistogram.reset();
+    fJankCount = 0;
+    fFrame = 0;
     fCurrentMeasurement = -1;
     fLastTotalBegin = 0;
     fCumulativeMeasurementTime = 0;
     fCumulativeMeasurementCount = 0;
 }
 
+void StatsLayer::setHistoryLength(int frames) {
+    fHistoryLength = SkNextPow2(std::max(frames, 2));
+    // Pending GPU results index into the old ring, so it is reallocated rather than resized.
+    fGpuTimer.fTimes.assign(fHistoryLength, 0);
+    this->resetMeasurements();
+}
+
 StatsLayer::Timer StatsLayer::addTimer(const char* label, SkColor color, SkColor labelColor) {
     Timer newTimer = fTimers.size();
     TimerData& newData = fTimers.push_back();
-    memset(newData.fTimes, 0, sizeof(newData.fTimes));
+    newData.fTimes.assign(fHistoryLength, 0);
+    newData.fCounts.assign(fHistoryLength, {});
     newData.fLabel = label;
     newData.fColor = color;
     newData.fLabelColor = labelColor ? labelColor : color;
@@ -58,19 +243,42 @@ StatsLayer::Timer StatsLayer::addTimer(const char* label, SkColor color, SkColor
 
 void StatsLayer::beginTiming(Timer timer) {
     if (fCurrentMeasurement >= 0) {
-        fTimers[timer].fTimes[fCurrentMeasurement] -= SkTime::GetMSecs();
+        double now = SkTime::GetMSecs();
+        fTimers[timer].fTimes[fCurrentMeasurement] -= now;
+        fTimers[timer].fBeginMS = now;
+        fTimers[timer].fBeginCounted =
+                fPerfCounters.isOpen() && fPerfCounters.read(&fTimers[timer].fBeginCounts);
     }
 }
 
 void StatsLayer::endTiming(Timer timer) {
     if (fCurrentMeasurement >= 0) {
-        fTimers[timer].fTimes[fCurrentMeasurement] += SkTime::GetMSecs();
+        TimerData& data = fTimers[timer];
+        PerfCounters::Sample counts;
+        bool counted = data.fBeginCounted && fPerfCounters.read(&counts);
+        double now = SkTime::GetMSecs();
+        data.fTimes[fCurrentMeasurement] += now;
+        if (counted) {
+            counts = counts - data.fBeginCounts;
+            // Multiplexed counts are extrapolated; an interval the group never ran is dropped.
+            counted = counts.scale();
+        }
+        if (counted) {
+            data.fCounts[fCurrentMeasurement] += counts;
+        }
+        data.fBeginCounted = false;
+        if (fExport) {
+            fExport->sample(Export::kCpuTrack, data.fLabel.c_str(), fSlideName, fFrame,
+                            data.fBeginMS, now - data.fBeginMS,
+                            counted ? &fPerfCounters : nullptr, &counts);
+        }
     }
 }
 
 void StatsLayer::enableGpuTimer(SkColor color) {
     fGpuTimer.fColor = color;
-    std::fill_n(fGpuTimer.fTimes, std::size(fGpuTimer.fTimes), 0);
+    std::fill(fGpuTimer.fTimes.begin(), fGpuTimer.fTimes.end(), 0);
+    fGpuTimer.fHistogram.reset();
     fGpuTimerEnabled = true;
 }
 
@@ -83,8 +291,19 @@ std::function<void(uint64_t ns)> StatsLayer::issueGpuTimer() {
     // The -1 indicates to the rendering code that we are still awaiting the result. Unlike the CPU
     // timers, there may be a multi-frame latency.
     fGpuTimer.fTimes[fCurrentMeasurement] = -1;
-    return [index = fCurrentMeasurement, layer = this](uint64_t ns) {
-        layer->fGpuTimer.fTimes[index] = static_cast<double>(ns) / 1000000.0;
+    return [index = fCurrentMeasurement, frame = fFrame, beginMS = fLastTotalBegin,
+            layer = this](uint64_t ns) {
+        if (index >= static_cast<int>(layer->fGpuTimer.fTimes.size())) {
+            return;
+        }
+        double ms = static_cast<double>(ns) / 1000000.0;
+        layer->fGpuTimer.fTimes[index] = ms;
+        layer->fGpuTimer.fHistogram.record(ms);
+        if (layer->fExport) {
+            // The GPU reports a duration only; it is placed at the start of its frame.
+            layer->fExport->sample(Export::kGpuTrack, "GPU", layer->fSlideName, frame, beginMS,
+                                   ms);
+        }
     };
 }
 
@@ -93,16 +312,35 @@ void StatsLayer::onPrePaint() {
         fTotalTimes[fCurrentMeasurement] = SkTime::GetMSecs() - fLastTotalBegin;
         fCumulativeMeasurementTime += fTotalTimes[fCurrentMeasurement];
         fCumulativeMeasurementCount++;
+
+        // The frame that just ended is complete; fold it into the histograms. Jank is judged on
+        // the timed work rather than the total, which also includes waiting for vsync.
+        double work = 0;
+        for (int i = 0; i < fTimers.size(); ++i) {
+            fTimers[i].fHistogram.record(fTimers[i].fTimes[fCurrentMeasurement]);
+            work += fTimers[i].fTimes[fCurrentMeasurement];
+        }
+        fTotalHistogram.record(fTotalTimes[fCurrentMeasurement]);
+        if (work > fFrameBudgetMS) {
+            fJankCount++;
+        }
+        if (fExport) {
+            fExport->sample(Export::kFrameTrack, "Frame", fSlideName, fFrame, fLastTotalBegin,
+                            fTotalTimes[fCurrentMeasurement]);
+        }
+        fFrame++;
     }
-    fCurrentMeasurement = (fCurrentMeasurement + 1) & (kMeasurementCount - 1);
-    SkASSERT(fCurrentMeasurement >= 0 && fCurrentMeasurement < kMeasurementCount);
+    fCurrentMeasurement = (fCurrentMeasurement + 1) & (fHistoryLength - 1);
+    SkASSERT(fCurrentMeasurement >= 0 && fCurrentMeasurement < fHistoryLength);
     fLastTotalBegin = SkTime::GetMSecs();
 }
 
 void StatsLayer::onPaint(SkSurface* surface) {
-    int nextMeasurement = (fCurrentMeasurement + 1) & (kMeasurementCount - 1);
+    const int mask = fHistoryLength - 1;  // fast mod
+    int nextMeasurement = (fCurrentMeasurement + 1) & mask;
     for (int i = 0; i < fTimers.size(); ++i) {
         fTimers[i].fTimes[nextMeasurement] = 0;
+        fTimers[i].fCounts[nextMeasurement] = {};
     }
 
 #ifdef SK_BUILD_FOR_ANDROID
@@ -116,19 +354,25 @@ void StatsLayer::onPaint(SkSurface* surface) {
 
     // Vertical height corresponding to 1 ms in the graph
     static const float kPixelPerMS = 2.0f;
-    // Horizontal spacing between measurements
-    static const int kPixelPerMeasurement = 3;
+    static const int kDisplayWidth = 330;
+    // The graph shows as much of the history as fits, spreading short histories out.
+    const int graphMeasurements = std::min(fHistoryLength, kDisplayWidth - 1);
     // We add one extra spacing on the left, hence the + 1
-    static const int kDisplayWidth = (kMeasurementCount + 1) * kPixelPerMeasurement;
+    const int pixelPerMeasurement = kDisplayWidth / (graphMeasurements + 1);
     static const int kGraphHeight = 100;
-    static const int kTextHeight = 60;
+    static const int kLineHeight = 14;
+    // Average line, table header, frame, one row per timer, GPU, jank, and with hardware
+    // counters another header and row per timer.
+    const bool showCounters = fPerfCounters.isOpen();
+    const int textLines = 4 + fTimers.size() + (fGpuTimerEnabled ? 1 : 0) +
+                          (showCounters ? 1 + fTimers.size() : 0);
+    const int textHeight = textLines * kLineHeight + 6;
     // The GPU graph is only shown if supported by the backend.
     const int gpuGraphHeight = fGpuTimerEnabled ? kGraphHeight : 0;
-    const int displayHeight = gpuGraphHeight + kGraphHeight + kTextHeight;
+    const int displayHeight = gpuGraphHeight + kGraphHeight + textHeight;
     // Padding between the graph and top/right edges of the canvas.
     static const int kDisplayPadding = 10;
-    // ms/frame to hit 60 fps
-    static const SkScalar kBaseMS = 1000.f / 60.f;
+    const SkScalar budgetMS = fFrameBudgetMS;
 
     auto canvas = surface->getCanvas();
     SkISize canvasSize = canvas->getBaseLayerSize();
@@ -150,43 +394,52 @@ void StatsLayer::onPaint(SkSurface* surface) {
 
     float cpuGraphBottom = rect.fBottom - gpuGraphHeight;
 
-    // draw the 16ms line
+    // draw the frame budget line
     paint.setColor(SK_ColorLTGRAY);
-    canvas->drawLine(rect.fLeft, cpuGraphBottom - kBaseMS*kPixelPerMS,
-                     rect.fRight, cpuGraphBottom - kBaseMS*kPixelPerMS, paint);
+    canvas->drawLine(rect.fLeft, cpuGraphBottom - budgetMS*kPixelPerMS,
+                     rect.fRight, cpuGraphBottom - budgetMS*kPixelPerMS, paint);
     paint.setColor(SK_ColorRED);
     paint.setStyle(SkPaint::kStroke_Style);
     canvas->drawRect(SkRect::MakeLTRB(rect.fLeft, rect.fTop, rect.fRight, cpuGraphBottom), paint);
     paint.setStyle(SkPaint::kFill_Style);
 
-    int x = SkScalarTruncToInt(rect.fLeft) + kPixelPerMeasurement;
-    int i = nextMeasurement;
+    const int graphTop = kDisplayPadding + textHeight;
+    int x = SkScalarTruncToInt(rect.fLeft) + pixelPerMeasurement;
     SkTDArray<double> sumTimes;
     sumTimes.resize(fTimers.size());
     memset(sumTimes.begin(), 0, sumTimes.size() * sizeof(double));
+    std::vector<PerfCounters::Sample> sumCounts(fTimers.size());
     int count = 0;
     double totalTime = 0;
     int totalCount = 0;
-    do {
+    for (int n = 0; n < fHistoryLength; ++n) {
+        int i = (nextMeasurement + n) & mask;
+        bool drawn = n >= fHistoryLength - graphMeasurements;
         int startY = SkScalarTruncToInt(cpuGraphBottom);
         double inc = 0;
         for (int timer = 0; timer < fTimers.size(); ++timer) {
             int height = (int)(fTimers[timer].fTimes[i] * kPixelPerMS + 0.5);
-            int endY = std::max(startY - height, kDisplayPadding + kTextHeight);
-            paint.setColor(fTimers[timer].fColor);
-            canvas->drawLine(SkIntToScalar(x), SkIntToScalar(startY),
-                             SkIntToScalar(x), SkIntToScalar(endY), paint);
+            int endY = std::max(startY - height, graphTop);
+            if (drawn) {
+                paint.setColor(fTimers[timer].fColor);
+                canvas->drawLine(SkIntToScalar(x), SkIntToScalar(startY),
+                                 SkIntToScalar(x), SkIntToScalar(endY), paint);
+            }
             startY = endY;
             inc += fTimers[timer].fTimes[i];
             sumTimes[timer] += fTimers[timer].fTimes[i];
+            sumCounts[timer] += fTimers[timer].fCounts[i];
         }
 
-        int height = (int)(fTotalTimes[i] * kPixelPerMS + 0.5);
-        height = std::max(0, height - (SkScalarTruncToInt(cpuGraphBottom) - startY));
-        int endY = std::max(startY - height, kDisplayPadding + kTextHeight);
-        paint.setColor(SK_ColorWHITE);
-        canvas->drawLine(SkIntToScalar(x), SkIntToScalar(startY),
-                         SkIntToScalar(x), SkIntToScalar(endY), paint);
+        if (drawn) {
+            int height = (int)(fTotalTimes[i] * kPixelPerMS + 0.5);
+            height = std::max(0, height - (SkScalarTruncToInt(cpuGraphBottom) - startY));
+            int endY = std::max(startY - height, graphTop);
+            paint.setColor(SK_ColorWHITE);
+            canvas->drawLine(SkIntToScalar(x), SkIntToScalar(startY),
+                             SkIntToScalar(x), SkIntToScalar(endY), paint);
+            x += pixelPerMeasurement;
+        }
         totalTime += fTotalTimes[i];
         if (fTotalTimes[i] > 0) {
             ++totalCount;
@@ -195,24 +448,91 @@ void StatsLayer::onPaint(SkSurface* surface) {
         if (inc > 0) {
             ++count;
         }
-
-        i++;
-        i &= (kMeasurementCount - 1);  // fast mod
-        x += kPixelPerMeasurement;
-    } while (i != nextMeasurement);
+    }
 
     SkFont font(ToolUtils::CreatePortableTypeface("sans-serif", SkFontStyle()), 14);
     paint.setColor(SK_ColorWHITE);
     double time = totalTime / std::max(1, totalCount);
     double measure = fCumulativeMeasurementTime / std::max(1, fCumulativeMeasurementCount);
+    SkScalar y = rect.fTop + kLineHeight;
     canvas->drawString(SkStringPrintf("C: %4.3f ms -> %4.3f ms", time, measure),
-                       rect.fLeft + 3, rect.fTop + 14, font, paint);
+                       rect.fLeft + 3, y, font, paint);
 
+    // Table of the ring average and the percentiles over every frame since the last reset.
+    static const SkScalar kLabelWidth = 70;
+    static const SkScalar kColumnWidth = 51;
+    auto drawRow = [&](const char* label, SkColor color, const char* columns[5], int n = 5) {
+        y += kLineHeight;
+        paint.setColor(color);
+        canvas->drawString(label, rect.fLeft + 3, y, font, paint);
+        for (int c = 0; c < n; ++c) {
+            canvas->drawString(columns[c], rect.fLeft + 3 + kLabelWidth + c * kColumnWidth, y,
+                               font, paint);
+        }
+    };
+    auto drawStats = [&](const char* label, SkColor color, double average, const Histogram& h) {
+        SkString values[5] = {
+            SkStringPrintf("%.2f", average),
+            SkStringPrintf("%.2f", h.quantileMS(0.50)),
+            SkStringPrintf("%.2f", h.quantileMS(0.90)),
+            SkStringPrintf("%.2f", h.quantileMS(0.99)),
+            SkStringPrintf("%.2f", h.maxMS()),
+        };
+        const char* columns[5];
+        for (int c = 0; c < 5; ++c) {
+            columns[c] = values[c].c_str();
+        }
+        drawRow(label, color, columns);
+    };
+    const char* header[5] = {"avg", "p50", "p90", "p99", "max"};
+    drawRow("ms", SK_ColorLTGRAY, header);
+    drawStats("Frame", SK_ColorWHITE, time, fTotalHistogram);
     for (int timer = 0; timer < fTimers.size(); ++timer) {
-        paint.setColor(fTimers[timer].fLabelColor);
-        canvas->drawString(SkStringPrintf("%s: %4.3f ms", fTimers[timer].fLabel.c_str(),
-                                          sumTimes[timer] / std::max(1, count)),
-                           rect.fLeft + 3, rect.fTop + 28 + (14 * timer), font, paint);
+        drawStats(fTimers[timer].fLabel.c_str(), fTimers[timer].fLabelColor,
+                  sumTimes[timer] / std::max(1, count), fTimers[timer].fHistogram);
+    }
+
+    // The GPU row is filled in below, once its ring has been walked.
+    SkScalar gpuRowY = y;
+    if (fGpuTimerEnabled) {
+        y += kLineHeight;
+    }
+
+    y += kLineHeight;
+    paint.setColor(fJankCount ? SK_ColorRED : SK_ColorWHITE);
+    canvas->drawString(SkStringPrintf("Jank: %d of %d frames > %.1f ms", fJankCount,
+                                      fTotalHistogram.count(), fFrameBudgetMS),
+                       rect.fLeft + 3, y, font, paint);
+
+    if (showCounters) {
+        // Per frame averages over the history. Misses are in thousands; '-' marks a counter
+        // that the CPU or the container does not provide.
+        const char* perfHeader[4] = {"Mcycles", "IPC", "kLLC", "kBrMiss"};
+        drawRow("perf", SK_ColorLTGRAY, perfHeader, 4);
+        for (int timer = 0; timer < fTimers.size(); ++timer) {
+            const uint64_t* sums = sumCounts[timer].fCounts;
+            double frames = std::max(1, count);
+            auto perFrame = [&](PerfCounters::Counter c, double scale) {
+                return fPerfCounters.has(c) ? SkStringPrintf("%.2f", sums[c] / frames / scale)
+                                            : SkString("-");
+            };
+            SkString values[4] = {
+                perFrame(PerfCounters::kCycles, 1e6),
+                fPerfCounters.has(PerfCounters::kCycles) &&
+                        fPerfCounters.has(PerfCounters::kInstructions) &&
+                        sums[PerfCounters::kCycles] > 0
+                    ? SkStringPrintf("%.2f", double(sums[PerfCounters::kInstructions]) /
+                                             sums[PerfCounters::kCycles])
+                    : SkString("-"),
+                perFrame(PerfCounters::kCacheMisses, 1e3),
+                perFrame(PerfCounters::kBranchMisses, 1e3),
+            };
+            const char* columns[4];
+            for (int c = 0; c < 4; ++c) {
+                columns[c] = values[c].c_str();
+            }
+            drawRow(fTimers[timer].fLabel.c_str(), fTimers[timer].fLabelColor, columns, 4);
+        }
     }
 
     if (!fGpuTimerEnabled) {
@@ -220,10 +540,10 @@ void StatsLayer::onPaint(SkSurface* surface) {
     }
 
     float gpuGraphBottom = rect.bottom();
-    // draw the 16ms line
+    // draw the frame budget line
     paint.setColor(SK_ColorLTGRAY);
-    canvas->drawLine(rect.fLeft, gpuGraphBottom - kBaseMS*kPixelPerMS,
-                     rect.fRight, gpuGraphBottom - kBaseMS*kPixelPerMS,
+    canvas->drawLine(rect.fLeft, gpuGraphBottom - budgetMS*kPixelPerMS,
+                     rect.fRight, gpuGraphBottom - budgetMS*kPixelPerMS,
                      paint);
     paint.setColor(SK_ColorRED);
     paint.setStyle(SkPaint::kStroke_Style);
@@ -231,13 +551,21 @@ void StatsLayer::onPaint(SkSurface* surface) {
                      paint);
     paint.setStyle(SkPaint::kFill_Style);
 
-    x = SkScalarTruncToInt(rect.fLeft) + kPixelPerMeasurement;
-    i = nextMeasurement;
+    x = SkScalarTruncToInt(rect.fLeft) + pixelPerMeasurement;
     totalCount = 0;
     totalTime = 0;
-    do {
+    for (int n = 0; n < fHistoryLength; ++n) {
+        int i = (nextMeasurement + n) & mask;
+        bool pending = fGpuTimer.fTimes[i] < 0;
+        if (!pending) {
+            ++totalCount;
+            totalTime += fGpuTimer.fTimes[i];
+        }
+        if (n < fHistoryLength - graphMeasurements) {
+            continue;
+        }
         int endY;
-        if (fGpuTimer.fTimes[i] < 0) {
+        if (pending) {
             // Draw a full height line with the color inverted to indicate a measurement
             // that is still pending.
             auto alpha = SkColorSetARGB(SkColorGetA(fGpuTimer.fColor), 0, 0, 0);
@@ -246,17 +574,12 @@ void StatsLayer::onPaint(SkSurface* surface) {
             endY = cpuGraphBottom;
         } else {
             paint.setColor(fGpuTimer.fColor);
-            ++totalCount;
-            totalTime += fGpuTimer.fTimes[i];
             float height = fGpuTimer.fTimes[i] * kPixelPerMS + 0.5f;
             endY = std::max(gpuGraphBottom - height, cpuGraphBottom);
         }
         canvas->drawLine(x, gpuGraphBottom, x, endY, paint);
-
-        i++;
-        i &= (kMeasurementCount - 1);  // fast mod
-        x += kPixelPerMeasurement;
-    } while (i != nextMeasurement);
+        x += pixelPerMeasurement;
+    }
     paint.setColor(SK_ColorWHITE);
     time = totalTime / std::max(1, totalCount);
     canvas->drawString(SkStringPrintf("G: %4.3f ms", time),
@@ -264,4 +587,6 @@ void StatsLayer::onPaint(SkSurface* surface) {
                        cpuGraphBottom + 14,
                        font,
                        paint);
+    y = gpuRowY;
+    drawStats("GPU", fGpuTimer.fColor, time, fGpuTimer.fHistogram);
 }
@@ -12,14 +12,66 @@
 #include "include/core/SkString.h"
 #include "include/private/base/SkTArray.h"
 #include "tools/sk_app/Window.h"
+#include "tools/viewer/PerfCounters.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
 
 class SkSurface;
 
 class StatsLayer : public sk_app::Window::Layer {
 public:
+    /**
+     *  Log-bucketed histogram of frame times, in the style of HdrHistogram: values are kept in
+     *  microseconds, exactly below 32 us and with 16 linear sub-buckets per power of two above
+     *  that, so any quantile is reported to within ~6% with a fixed, small amount of memory.
+     */
+    class Histogram {
+    public:
+        Histogram() { this->reset(); }
+        void reset();
+        void record(double ms);
+
+        int count() const { return fCount; }
+        double maxMS() const { return fMaxMS; }
+        // Returns the upper bound of the bucket containing quantile q (0..1), in ms.
+        double quantileMS(double q) const;
+
+    private:
+        static constexpr int kSubBuckets = 16;
+        static constexpr int kBucketCount = kSubBuckets * 28;  // up to INT32_MAX us
+
+        uint32_t fBuckets[kBucketCount];
+        int fCount;
+        double fMaxMS;
+    };
+
     StatsLayer();
+    ~StatsLayer() override;
     void resetMeasurements();
 
+    // Number of frames kept for the graph and the running averages; rounded up to a power of 2.
+    void setHistoryLength(int frames);
+    // Frames whose timed work (the sum of all timers) exceeds the budget are counted as jank.
+    void setFrameBudget(double ms) { fFrameBudgetMS = ms; }
+
+    // Streams every timer sample, the GPU timer and the total frame time to a file until
+    // stopExport(): CSV if the path ends in .csv, otherwise Chrome trace-event JSON, which
+    // chrome://tracing and Perfetto can load.
+    bool startExport(const char* path);
+    void stopExport();
+    bool isExporting() const { return fExport != nullptr; }
+    // Recorded with each exported sample; frame numbers restart with resetMeasurements().
+    void setSlideName(const SkString& name) { fSlideName = name; }
+
+    // Samples cycles, instructions, cache misses and branch misses around every timer, on the
+    // calling thread. Returns false if perf_event_open is unavailable (non-Linux, restricted
+    // perf_event_paranoid, or a container that filters the syscall).
+    bool enablePerfCounters();
+    void disablePerfCounters();
+    bool hasPerfCounters() const { return fPerfCounters.isOpen(); }
+
     typedef int Timer;
 
     Timer addTimer(const char* label, SkColor color, SkColor labelColor = 0);
@@ -37,19 +89,35 @@ public:
     void setDisplayScale(float scale) { fDisplayScale = scale; }
 
 private:
-    static const int kMeasurementCount = 1 << 6;  // should be power of 2 for fast mod
+    static const int kDefaultHistoryLength = 1 << 6;
+    struct Export;
+
     struct TimerData {
-        double fTimes[kMeasurementCount];
+        std::vector<double> fTimes;
+        double fBeginMS = 0;
+        std::vector<PerfCounters::Sample> fCounts;
+        PerfCounters::Sample fBeginCounts;
+        bool fBeginCounted = false;  // whether fBeginCounts was read for the current interval
+        Histogram fHistogram;
         SkString fLabel;
         SkColor fColor;
         SkColor fLabelColor;
     };
     skia_private::TArray<TimerData> fTimers;
-    double fTotalTimes[kMeasurementCount];
+    std::vector<double> fTotalTimes;
+    Histogram fTotalHistogram;
+    int fJankCount;
+    double fFrameBudgetMS;
 
     TimerData fGpuTimer;
     bool fGpuTimerEnabled = false;
 
+    PerfCounters fPerfCounters;
+    std::unique_ptr<Export> fExport;
+    SkString fSlideName;
+    int fFrame;
+
+    int fHistoryLength;  // power of 2 for fast mod
     int fCurrentMeasurement;
     double fLastTotalBegin;
     double fCumulativeMeasurementTime;
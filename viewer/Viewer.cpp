@@ -283,6 +283,30 @@ static DEFINE_bool(redraw, false, "Toggle continuous redraw.");
 
 static DEFINE_bool(offscreen, false, "Force rendering to an offscreen surface.");
 static DEFINE_bool(stats, false, "Display stats overlay on startup.");
+static DEFINE_bool(memStats, false, "Display memory overlay on startup.");
+static DEFINE_int(statsHistory, 64, "Number of frames graphed and averaged by the stats overlay.");
+static DEFINE_double(statsBudget, 1000.0 / 60.0,
+                     "Frame budget in ms; frames whose timed work exceeds it count as jank.");
+static DEFINE_bool(perfCounters, false,
+                   "Sample hardware performance counters (Linux perf_event_open) around each "
+                   "stats timer, and show IPC and cache and branch misses per frame.");
+static DEFINE_string(statsExport, "",
+                     "Stream frame timings to this file from startup (CSV if it ends in .csv, "
+                     "Chrome trace JSON otherwise). The 'E' key toggles the export.");
+
+static DEFINE_bool(bench, false,
+                   "Headless benchmark: render every slide matched by --match offscreen on the "
+                   "raster backend, write per-slide CPU times as JSON, and exit.");
+static DEFINE_int(benchWarmup, 10, "Number of unmeasured frames per slide in --bench mode.");
+static DEFINE_int(benchFrames, 100, "Number of measured frames per slide in --bench mode.");
+static DEFINE_int(benchScoreSeconds, 120,
+                  "In --bench mode, how long a slide that measures its own score may keep "
+                  "rendering after its measured frames. The MotionMark ramp "
+                  "(--motionMarkController ramp) runs on real frame times and needs roughly "
+                  "15-30 s, i.e. well over --benchFrames frames.");
+static DEFINE_int(benchWidth, 1280, "Surface width for slides without their own size in --bench.");
+static DEFINE_int(benchHeight, 960, "Surface height for slides without their own size in --bench.");
+static DEFINE_string(benchJson, "", "File to write --bench results to; stdout if empty.");
 static DEFINE_bool(createProtected, false, "Create a protected native backend (e.g., in EGL).");
 
 #ifndef SK_GL
@@ -587,6 +611,12 @@ Viewer::Viewer(int argc, char** argv, void* platformData)
     initializeEventTracingForTools();
     static SkTaskGroup::Enabler kTaskGroupEnabler(FLAGS_threads);
 
+    if (FLAGS_bench) {
+        // No window, no GPU context: only the slides and a raster surface are needed.
+        this->initSlides();
+        exit(this->runHeadlessBench());
+    }
+
     fBackendType = get_backend_type(FLAGS_backend[0]);
     fWindow = Windows::CreateNativeWindow(platformData);
 
@@ -620,17 +650,28 @@ Viewer::Viewer(int argc, char** argv, void* platformData)
 
     fImGuiLayer.setScaleFactor(fWindow->scaleFactor());
     fStatsLayer.setDisplayScale((fZoomUI ? 2.0f : 1.0f) * fWindow->scaleFactor());
+    fMemoryLayer.setDisplayScale((fZoomUI ? 2.0f : 1.0f) * fWindow->scaleFactor());
 
     // Configure timers
     fStatsLayer.setActive(FLAGS_stats);
+    fMemoryLayer.setActive(FLAGS_memStats);
+    fStatsLayer.setHistoryLength(FLAGS_statsHistory);
+    fStatsLayer.setFrameBudget(FLAGS_statsBudget);
+    if (!FLAGS_statsExport.isEmpty() && !fStatsLayer.startExport(FLAGS_statsExport[0])) {
+        SkDebugf("Cannot open %s for stats export\n", FLAGS_statsExport[0]);
+    }
     fAnimateTimer = fStatsLayer.addTimer("Animate", SK_ColorMAGENTA, 0xffff66ff);
     fPaintTimer = fStatsLayer.addTimer("Paint", SK_ColorGREEN);
     fFlushTimer = fStatsLayer.addTimer("Flush", SK_ColorRED, 0xffff6666);
+    if (FLAGS_perfCounters && !fStatsLayer.enablePerfCounters()) {
+        SkDebugf("Hardware performance counters are unavailable; showing times only\n");
+    }
 
     // register callbacks
     fCommands.attach(fWindow);
     fWindow->pushLayer(this);
     fWindow->pushLayer(&fStatsLayer);
+    fWindow->pushLayer(&fMemoryLayer);
     fWindow->pushLayer(&fImGuiLayer);
 
     // add key-bindings
@@ -688,9 +729,27 @@ Viewer::Viewer(int argc, char** argv, void* platformData)
     });
     fCommands.addCommand('0', "Overlays", "Reset stats", [this]() {
         fStatsLayer.resetMeasurements();
+        fMemoryLayer.resetMeasurements();
         this->updateTitle();
         fWindow->inval();
     });
+    fCommands.addCommand('M', "Overlays", "Toggle memory display", [this]() {
+        fMemoryLayer.setActive(!fMemoryLayer.getActive());
+        fWindow->inval();
+    });
+    fCommands.addCommand('E', "Overlays", "Toggle stats export", [this]() {
+        if (fStatsLayer.isExporting()) {
+            fStatsLayer.stopExport();
+            return;
+        }
+        const char* path = FLAGS_statsExport.isEmpty() ? "viewer_stats.json"
+                                                       : FLAGS_statsExport[0];
+        if (fStatsLayer.startExport(path)) {
+            SkDebugf("Exporting stats to %s\n", path);
+        } else {
+            SkDebugf("Cannot open %s for stats export\n", path);
+        }
+    });
     fCommands.addCommand('C', "GUI", "Toggle color histogram", [this]() {
         this->fShowHistogramWindow = !this->fShowHistogramWindow;
         fWindow->inval();
@@ -902,6 +961,7 @@ Viewer::Viewer(int argc, char** argv, void* platformData)
     fCommands.addCommand('u', "GUI", "Zoom UI", [this]() {
         fZoomUI = !fZoomUI;
         fStatsLayer.setDisplayScale((fZoomUI ? 2.0f : 1.0f) * fWindow->scaleFactor());
+        fMemoryLayer.setDisplayScale((fZoomUI ? 2.0f : 1.0f) * fWindow->scaleFactor());
         fWindow->inval();
     });
     fCommands.addCommand('=', "Transform", "Apply Backing Scale", [this]() {
@@ -1413,6 +1473,121 @@ void Viewer::listNames() const {
     }
 }
 
+int Viewer::runHeadlessBench() {
+    using Clock = std::chrono::steady_clock;
+    const int warmup = std::max(0, FLAGS_benchWarmup);
+    const int frames = std::max(1, FLAGS_benchFrames);
+
+    SkDynamicMemoryWStream json;
+    SkJSONWriter writer(&json, SkJSONWriter::Mode::kPretty);
+    writer.beginObject();
+    writer.appendCString("backend", "raster");
+    writer.appendS32("warmupFrames", warmup);
+    writer.appendS32("measuredFrames", frames);
+    writer.beginArray("slides");
+
+    // Each frame advances a synthetic 60 Hz clock, so animated slides are measured on the same
+    // sequence of states in every run regardless of how long a frame actually takes.
+    constexpr double kFrameNanos = 1e9 / 60;
+    for (const sk_sp<Slide>& slide : fSlides) {
+        SkISize size = slide->getDimensions();
+        if (size.isEmpty()) {
+            size = {FLAGS_benchWidth, FLAGS_benchHeight};
+        }
+        sk_sp<SkSurface> surface = SkSurfaces::Raster(
+                SkImageInfo::MakeN32Premul(size.width(), size.height()));
+        if (!surface) {
+            SkDebugf("Skipping %s: cannot allocate a %dx%d surface\n",
+                     slide->getName().c_str(), size.width(), size.height());
+            continue;
+        }
+        SkCanvas* canvas = surface->getCanvas();
+
+        slide->load(size.width(), size.height());
+        double nanos = 0;
+        std::vector<double> drawMs, animateMs;
+        drawMs.reserve(frames);
+        animateMs.reserve(frames);
+        for (int i = 0; i < warmup + frames; ++i) {
+            nanos += kFrameNanos;
+            auto t0 = Clock::now();
+            slide->animate(nanos);
+            auto t1 = Clock::now();
+            canvas->clear(SK_ColorWHITE);
+            slide->draw(canvas);
+            auto t2 = Clock::now();
+            if (i >= warmup) {
+                animateMs.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+                drawMs.push_back(std::chrono::duration<double, std::milli>(t2 - t1).count());
+            }
+        }
+        // Keep rendering, unmeasured, until a slide that scores itself has finished.
+        const auto scoreDeadline = Clock::now() + std::chrono::seconds(FLAGS_benchScoreSeconds);
+        while (slide->isScorePending() && Clock::now() < scoreDeadline) {
+            nanos += kFrameNanos;
+            slide->animate(nanos);
+            canvas->clear(SK_ColorWHITE);
+            slide->draw(canvas);
+        }
+        double score = 0;
+        bool hasScore = slide->getScore(&score);
+        if (!hasScore && slide->isScorePending()) {
+            SkDebugf("%s: no score after %d s; raise --benchScoreSeconds\n",
+                     slide->getName().c_str(), FLAGS_benchScoreSeconds);
+        }
+        slide->unload();
+
+        auto mean = [](const std::vector<double>& v) {
+            double sum = 0;
+            for (double x : v) {
+                sum += x;
+            }
+            return sum / v.size();
+        };
+        double animateMean = mean(animateMs);
+        double drawMean = mean(drawMs);
+        std::sort(drawMs.begin(), drawMs.end());
+        auto percentile = [&drawMs](double p) {
+            return drawMs[std::min(drawMs.size() - 1, static_cast<size_t>(p * drawMs.size()))];
+        };
+
+        writer.beginObject();
+        writer.appendString("name", slide->getName());
+        writer.appendS32("width", size.width());
+        writer.appendS32("height", size.height());
+        writer.appendDouble("animateMeanMs", animateMean);
+        writer.beginObject("drawMs");
+        writer.appendDouble("mean", drawMean);
+        writer.appendDouble("min", drawMs.front());
+        writer.appendDouble("p50", percentile(0.50));
+        writer.appendDouble("p90", percentile(0.90));
+        writer.appendDouble("p99", percentile(0.99));
+        writer.appendDouble("max", drawMs.back());
+        writer.endObject();
+        if (hasScore) {
+            writer.appendDouble("score", score);
+        }
+        writer.endObject();
+    }
+
+    writer.endArray();
+    writer.endObject();
+    writer.flush();
+    json.writeText("\n");
+
+    sk_sp<SkData> data = json.detachAsData();
+    if (FLAGS_benchJson.isEmpty()) {
+        fwrite(data->data(), 1, data->size(), stdout);
+        return 0;
+    }
+    SkFILEWStream file(FLAGS_benchJson[0]);
+    if (!file.isValid() || !file.write(data->data(), data->size())) {
+        SkDebugf("Cannot write %s\n", FLAGS_benchJson[0]);
+        return 1;
+    }
+    return 0;
+}
+
 void Viewer::setCurrentSlide(int slide) {
     SkASSERT(slide >= 0 && slide < fSlides.size());
 
@@ -1465,6 +1640,8 @@ void Viewer::setupCurrentSlide() {
         this->updateUIState();
 
         fStatsLayer.resetMeasurements();
+        fMemoryLayer.resetMeasurements();
+        fStatsLayer.setSlideName(fSlides[fCurrentSlide]->getName());
 
         fWindow->inval();
     }
@@ -1551,6 +1728,7 @@ void Viewer::setBackend(sk_app::Window::BackendType backendType) {
     fCommands.attach(fWindow);
     fWindow->pushLayer(this);
     fWindow->pushLayer(&fStatsLayer);
+    fWindow->pushLayer(&fMemoryLayer);
     fWindow->pushLayer(&fImGuiLayer);
 
     // Don't allow the window to re-attach. If we're in MSAA mode, the params we grabbed above
@@ -1986,6 +2164,7 @@ void Viewer::onResize(int width, int height) {
 
     fImGuiLayer.setScaleFactor(fWindow->scaleFactor());
     fStatsLayer.setDisplayScale((fZoomUI ? 2.0f : 1.0f) * fWindow->scaleFactor());
+    fMemoryLayer.setDisplayScale((fZoomUI ? 2.0f : 1.0f) * fWindow->scaleFactor());
 }
 
 SkPoint Viewer::mapEvent(float x, float y) {
@@ -2803,6 +2982,43 @@ void Viewer::drawImGui() {
                 }
             }
 
+            if (ImGui::CollapsingHeader("Memory")) {
+                bool showMemory = fMemoryLayer.getActive();
+                if (ImGui::Checkbox("Show memory overlay", &showMemory)) {
+                    fMemoryLayer.setActive(showMemory);
+                }
+                if (!MemoryLayer::CountsAllocations()) {
+                    ImGui::Text("Allocation counting is not available in this build");
+                }
+
+                // Budgets in MB; shrinking one purges down to the new limit right away.
+                constexpr size_t kMB = 1024 * 1024;
+                int fontCacheMB = SkTo<int>(SkGraphics::GetFontCacheLimit() / kMB);
+                if (ImGui::SliderInt("Font cache (MB)", &fontCacheMB, 1, 256)) {
+                    SkGraphics::SetFontCacheLimit(fontCacheMB * kMB);
+                }
+                int glyphCaches = SkGraphics::GetFontCacheCountLimit();
+                if (ImGui::SliderInt("Glyph caches", &glyphCaches, 1, 4096)) {
+                    SkGraphics::SetFontCacheCountLimit(glyphCaches);
+                }
+                int resourceCacheMB = SkTo<int>(SkGraphics::GetResourceCacheTotalByteLimit() / kMB);
+                if (ImGui::SliderInt("Resource cache (MB)", &resourceCacheMB, 1, 1024)) {
+                    SkGraphics::SetResourceCacheTotalByteLimit(resourceCacheMB * kMB);
+                }
+                if (auto ctx = fWindow->directContext()) {
+                    int gpuCacheMB = SkTo<int>(ctx->getResourceCacheLimit() / kMB);
+                    if (ImGui::SliderInt("GPU resource cache (MB)", &gpuCacheMB, 1, 2048)) {
+                        ctx->setResourceCacheLimit(gpuCacheMB * kMB);
+                    }
+                    size_t gpuBytes = 0;
+                    ctx->getResourceCacheUsage(nullptr, &gpuBytes);
+                    ImGui::Text("GPU resource cache: %.1f MB used", gpuBytes / double(kMB));
+                }
+                if (ImGui::Button("Purge all caches")) {
+                    SkGraphics::PurgeAllCaches();
+                }
+            }
+
             if (ImGui::CollapsingHeader("Shaders")) {
                 bool sksl = params->grContextOptions().fShaderCacheStrategy ==
                             GrContextOptions::ShaderCacheStrategy::kSkSL;
@@ -3258,7 +3474,7 @@ void Viewer::onIdle() {
     // not be visible, though. So we need to redraw if there is at least one visible window, or
     // more than one active window. Newly created windows are active but not visible for one frame
     // while they determine their layout and sizing.
-    if (animateWantsInval || fStatsLayer.getActive() || fRefresh ||
+    if (animateWantsInval || fStatsLayer.getActive() || fMemoryLayer.getActive() || fRefresh ||
         io.MetricsActiveWindows > 1 || io.MetricsRenderWindows > 0) {
         fWindow->inval();
     }
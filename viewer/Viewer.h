@@ -22,6 +22,7 @@
 #include "tools/sk_app/Window.h"
 #include "tools/viewer/AnimTimer.h"
 #include "tools/viewer/ImGuiLayer.h"
+#include "tools/viewer/MemoryLayer.h"
 #include "tools/viewer/StatsLayer.h"
 #include "tools/viewer/TouchGesture.h"
 #include "tools/window/DisplayParams.h"
@@ -159,6 +160,7 @@ private:
     void setupCurrentSlide();
     SkISize currentSlideSize() const;
     void listNames() const;
+    int runHeadlessBench();
     void dumpShadersToResources();
 
     void updateUIState();
@@ -176,6 +178,7 @@ private:
     sk_app::Window*        fWindow;
 
     StatsLayer             fStatsLayer;
+    MemoryLayer            fMemoryLayer;
     StatsLayer::Timer      fPaintTimer;
     StatsLayer::Timer      fFlushTimer;
     StatsLayer::Timer      fAnimateTimer;
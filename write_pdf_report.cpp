@@ -0,0 +1,208 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+// A many-page version of write_to_pdf.cpp.
+//
+// SkPDF writes each page's content to the output stream as soon as the page is ended, so
+// memory stays flat as long as the page content itself is not retained: we draw every page
+// directly and reuse one chart image (SkPDF emits an image once per unique ID). Setting
+// SkPDF::Metadata::fExecutor lets SkPDF deflate page content and images on a thread pool
+// while the next page is being drawn.
+//
+// Prints the time spent per page and the resident set size every so often, and the peak
+// RSS at the end.
+
+#include "include/core/SkCanvas.h"
+#include "include/core/SkColor.h"
+#include "include/core/SkDocument.h"
+#include "include/core/SkExecutor.h"
+#include "include/core/SkFont.h"
+#include "include/core/SkFontMgr.h"
+#include "include/core/SkFontStyle.h"
+#include "include/core/SkImage.h"
+#include "include/core/SkImageInfo.h"
+#include "include/core/SkPaint.h"
+#include "include/core/SkRect.h"
+#include "include/core/SkRefCnt.h"
+#include "include/core/SkStream.h"
+#include "include/core/SkString.h"
+#include "include/core/SkSurface.h"
+#include "include/core/SkTypeface.h"
+#include "include/docs/SkPDFDocument.h"
+
+#if defined(SK_FONTMGR_FONTCONFIG_AVAILABLE)
+#include "include/ports/SkFontMgr_fontconfig.h"
+#endif
+
+#if defined(SK_FONTMGR_CORETEXT_AVAILABLE)
+#include "include/ports/SkFontMgr_mac_ct.h"
+#endif
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+constexpr SkScalar kPageWidth = 612;   // US Letter, in points
+constexpr SkScalar kPageHeight = 792;
+constexpr int kRowsPerPage = 40;
+
+static long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;  // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+static long current_rss_kb() {
+#if defined(__linux__)
+    long pages = 0, resident = 0;
+    if (FILE* f = fopen("/proc/self/statm", "r")) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+    return peak_rss_kb();
+#endif
+}
+
+static sk_sp<SkImage> make_chart() {
+    auto surface = SkSurfaces::Raster(SkImageInfo::MakeN32Premul(400, 200));
+    SkCanvas* canvas = surface->getCanvas();
+    canvas->clear(SK_ColorWHITE);
+    SkPaint bar;
+    bar.setAntiAlias(true);
+    for (int i = 0; i < 20; ++i) {
+        bar.setColor(i % 2 ? 0xFF4285F4 : 0xFF34A853);
+        SkScalar h = 20 + (i * 37) % 170;
+        canvas->drawRect(SkRect::MakeXYWH(10 + i * 19, 195 - h, 15, h), bar);
+    }
+    return surface->makeImageSnapshot();
+}
+
+static void draw_page(SkCanvas* canvas, int page, const SkFont& font, const SkFont& bold,
+                      const sk_sp<SkImage>& chart) {
+    SkPaint text;
+    text.setColor(SK_ColorBLACK);
+    SkPaint rule;
+    rule.setColor(SK_ColorLTGRAY);
+
+    SkString title = SkStringPrintf("Quarterly report - page %d", page + 1);
+    canvas->drawString(title, 40, 50, bold, text);
+    canvas->drawImage(chart, 106, 70);
+
+    SkScalar y = 300;
+    for (int row = 0; row < kRowsPerPage; ++row) {
+        int id = page * kRowsPerPage + row;
+        canvas->drawString(SkStringPrintf("%08d", id), 40, y, font, text);
+        canvas->drawString(SkStringPrintf("Item %d", id % 977), 140, y, font, text);
+        canvas->drawString(SkStringPrintf("%10.2f", (id * 7919 % 100000) / 100.0), 460, y,
+                           font, text);
+        canvas->drawLine(40, y + 3, kPageWidth - 40, y + 3, rule);
+        y += 12;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s <name.pdf> [pages] [threads]\n", argv[0]);
+        return 1;
+    }
+    int pages = argc > 2 ? atoi(argv[2]) : 5000;
+    int threads = argc > 3 ? atoi(argv[3])
+                           : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    if (pages <= 0 || threads < 0) {
+        printf("Usage: %s <name.pdf> [pages] [threads]\n", argv[0]);
+        return 1;
+    }
+
+    SkFILEWStream output(argv[1]);
+    if (!output.isValid()) {
+        printf("Cannot open output file %s\n", argv[1]);
+        return 1;
+    }
+
+#if defined(SK_FONTMGR_FONTCONFIG_AVAILABLE)
+    sk_sp<SkFontMgr> mgr = SkFontMgr_New_FontConfig(nullptr);
+#endif
+#if defined(SK_FONTMGR_CORETEXT_AVAILABLE)
+    sk_sp<SkFontMgr> mgr = SkFontMgr_New_CoreText(nullptr);
+#endif
+
+    sk_sp<SkTypeface> face = mgr->matchFamilyStyle("Roboto", SkFontStyle());
+    sk_sp<SkTypeface> boldFace = mgr->matchFamilyStyle("Roboto", SkFontStyle::Bold());
+    if (!face) {
+        printf("Cannot open typeface\n");
+        return 1;
+    }
+    SkFont font(face, 10);
+    SkFont bold(boldFace ? boldFace : face, 18);
+    sk_sp<SkImage> chart = make_chart();
+
+    // With no executor SkPDF compresses on the calling thread.
+    std::unique_ptr<SkExecutor> executor;
+    if (threads > 0) {
+        executor = SkExecutor::MakeFIFOThreadPool(threads);
+    }
+
+    SkPDF::Metadata metadata;
+    metadata.fTitle = "Test PDF";
+    metadata.fAuthor = "Skia Demo Writer";
+    metadata.fLang = "eng";
+    metadata.fEncodingQuality = 90;
+    metadata.fExecutor = executor.get();
+
+    sk_sp<SkDocument> pdf = SkPDF::MakeDocument(&output, metadata);
+    if (!pdf) {
+        printf("Cannot create PDF document\n");
+        return 1;
+    }
+
+    const int reportEvery = std::max(1, pages / 10);
+    std::vector<double> pageMs;
+    pageMs.reserve(pages);
+    auto start = Clock::now();
+    for (int page = 0; page < pages; ++page) {
+        auto t0 = Clock::now();
+        SkCanvas* canvas = pdf->beginPage(kPageWidth, kPageHeight);
+        draw_page(canvas, page, font, bold, chart);
+        pdf->endPage();
+        pageMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+
+        if ((page + 1) % reportEvery == 0) {
+            printf("page %6d  %7.3f ms  rss %7ld KB  written %9zu bytes\n", page + 1,
+                   pageMs.back(), current_rss_kb(), output.bytesWritten());
+        }
+    }
+    auto t0 = Clock::now();
+    pdf->close();
+    double closeMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    double totalMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    output.flush();
+
+    std::sort(pageMs.begin(), pageMs.end());
+    printf("%d pages, %d threads: %.1f ms total, close %.1f ms, %.0f pages/s\n", pages, threads,
+           totalMs, closeMs, pages * 1000.0 / totalMs);
+    printf("per page: p50 %.3f ms  p99 %.3f ms  max %.3f ms\n", pageMs[pageMs.size() / 2],
+           pageMs[pageMs.size() * 99 / 100], pageMs.back());
+    printf("output %zu bytes, peak rss %ld KB\n", output.bytesWritten(), peak_rss_kb());
+    return 0;
+}